@@ -0,0 +1,120 @@
+#include "CaptureThread.hpp"
+#include "PacketCapture.hpp"
+#include "SWPacketCapture.hpp"
+#include "DecoderShards.hpp"
+#include "EventQueue.hpp"
+
+#include <QDebug>
+
+using namespace std;
+
+CaptureThread::CaptureThread(unique_ptr<PacketCapture> packetCapture, EventQueue &eventQueue, uint32_t nDecoders)
+    : m_packetCapture(move(packetCapture))
+{
+    setObjectName("CaptureThread");
+
+    m_packetCapture->moveToThread(this);
+
+    const auto eventConsumer = [&eventQueue](const DpsEvent *events, size_t count) {
+        eventQueue.push(events, count);
+    };
+
+    if (nDecoders <= 1)
+    {
+        m_swPacketCapture = make_unique<SWPacketCapture>();
+        m_swPacketCapture->moveToThread(this);
+
+        connect(
+            m_packetCapture.get(), &PacketCapture::newPacket,
+            m_swPacketCapture.get(), &SWPacketCapture::newPacket,
+            Qt::DirectConnection
+        );
+        connect(
+            m_packetCapture.get(), &PacketCapture::flowReset,
+            m_swPacketCapture.get(), &SWPacketCapture::resetFlow,
+            Qt::DirectConnection
+        );
+
+        m_swPacketCapture->setEventConsumer(eventConsumer);
+        return;
+    }
+
+    // The merge thread is the only producer of the event queue
+    m_decoderShards = make_unique<DecoderShards>(nDecoders);
+    m_decoderShards->setEventConsumer(eventConsumer);
+
+    // Flows are tracked by the workers, so there are none to narrow the kernel filter to
+    m_packetCapture->setDynamicFilter(false);
+    m_packetCapture->setPacketForwarder([shards = m_decoderShards.get()](const uint8_t *packet, qsizetype len, int64_t timestamp) {
+        shards->addPacket(packet, len, timestamp);
+    });
+
+    // Before anyone else learns about the end of the capture file, all its events must be delivered
+    connect(
+        m_packetCapture.get(), &PacketCapture::finished,
+        m_packetCapture.get(), [this] {
+            m_decoderShards->flush();
+        },
+        Qt::DirectConnection
+    );
+}
+CaptureThread::~CaptureThread()
+{
+    quit();
+    wait();
+}
+
+void CaptureThread::setBlocking(bool blocking)
+{
+    if (m_decoderShards)
+        m_decoderShards->setBlocking(blocking);
+}
+
+bool CaptureThread::init(uint16_t port)
+{
+    if (m_decoderShards)
+        m_decoderShards->start(port);
+
+    start();
+
+    bool ok = false;
+    QMetaObject::invokeMethod(m_packetCapture.get(), [&] {
+        ok = m_packetCapture->init(port);
+    }, Qt::BlockingQueuedConnection);
+    return ok;
+}
+
+void CaptureThread::resetCapture()
+{
+    m_packetCapture->reset();
+    if (m_decoderShards)
+        m_decoderShards->reset();
+}
+
+uint32_t CaptureThread::getNumDecoders() const
+{
+    return m_decoderShards ? m_decoderShards->getNumWorkers() : 1;
+}
+SWPacketCapture *CaptureThread::getDecoder(uint32_t idx) const
+{
+    return m_decoderShards ? m_decoderShards->getDecoder(idx) : m_swPacketCapture.get();
+}
+
+uint64_t CaptureThread::getNumPayloadPackets() const
+{
+    return m_decoderShards ? m_decoderShards->getNumPayloadPackets() : m_packetCapture->getNumPayloadPackets();
+}
+uint64_t CaptureThread::getNumDecoderDrops() const
+{
+    return m_decoderShards ? m_decoderShards->getNumDrops() : 0;
+}
+
+void CaptureThread::run()
+{
+    exec();
+
+    // Capture objects live in this thread, so destroy them here, the capture feeds the decoders
+    m_packetCapture.reset();
+    m_swPacketCapture.reset();
+    m_decoderShards.reset();
+}
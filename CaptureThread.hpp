@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QThread>
+
+#include <memory>
+
+class PacketCapture;
+class SWPacketCapture;
+class DecoderShards;
+class EventQueue;
+
+// Runs packet capture, TCP reassembly and decoding outside of the GUI thread,
+// with more than one decoder the connections are decoded in parallel by "DecoderShards"
+class CaptureThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    CaptureThread(std::unique_ptr<PacketCapture> packetCapture, EventQueue &eventQueue, uint32_t nDecoders = 1);
+    ~CaptureThread();
+
+    // Wait for busy decoders instead of dropping packets, for replays, set before "init()"
+    void setBlocking(bool blocking);
+
+    bool init(uint16_t port);
+
+    // Capture thread only, closes all connections
+    void resetCapture();
+
+    inline PacketCapture *getPacketCapture() const;
+
+    uint32_t getNumDecoders() const;
+    SWPacketCapture *getDecoder(uint32_t idx) const;
+
+    // Any thread
+    uint64_t getNumPayloadPackets() const;
+    uint64_t getNumDecoderDrops() const;
+
+private:
+    void run() override;
+
+private:
+    std::unique_ptr<PacketCapture> m_packetCapture;
+    std::unique_ptr<SWPacketCapture> m_swPacketCapture; // Single decoder
+    std::unique_ptr<DecoderShards> m_decoderShards;
+};
+
+inline PacketCapture *CaptureThread::getPacketCapture() const
+{
+    return m_packetCapture.get();
+}
@@ -0,0 +1,75 @@
+#include "DamageTimeline.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+static_assert((DamageTimeline::s_nBuckets & (DamageTimeline::s_nBuckets - 1)) == 0);
+static_assert(DamageTimeline::s_windows.back() < DamageTimeline::s_nBuckets);
+
+DamageTimeline::DamageTimeline()
+{
+}
+DamageTimeline::~DamageTimeline()
+{
+}
+
+void DamageTimeline::reserve(size_t size)
+{
+    m_buckets.reserve(size * s_nBuckets);
+    m_lastSeconds.reserve(size);
+    m_sums.reserve(size);
+    m_peaks.reserve(size);
+}
+void DamageTimeline::addRow()
+{
+    m_buckets.resize(m_buckets.size() + s_nBuckets, 0);
+    m_lastSeconds.push_back(0);
+    m_sums.push_back({});
+    m_peaks.push_back(0.0);
+}
+void DamageTimeline::clear()
+{
+    m_buckets.clear();
+    m_lastSeconds.clear();
+    m_sums.clear();
+    m_peaks.clear();
+}
+
+uint64_t DamageTimeline::getDamage(uint32_t row, uint32_t window, int64_t second) const
+{
+    const auto lastSecond = m_lastSeconds[row];
+    const auto windowSize = s_windows[window];
+
+    if (second - lastSecond >= windowSize)
+        return 0;
+
+    // Buckets which left the window since the last damage, at most one window of them
+    uint64_t damage = m_sums[row][window];
+    for (int64_t s = lastSecond + 1; s <= second; ++s)
+        damage -= getBucket(row, s - windowSize);
+    return damage;
+}
+
+void DamageTimeline::advance(uint32_t row, int64_t second)
+{
+    auto &lastSecond = m_lastSeconds[row];
+    auto &sums = m_sums[row];
+
+    if (second - lastSecond >= s_nBuckets)
+    {
+        // Idle longer than any window
+        fill_n(m_buckets.begin() + row * s_nBuckets, s_nBuckets, 0);
+        sums = {};
+        lastSecond = second;
+        return;
+    }
+
+    for (int64_t s = lastSecond + 1; s <= second; ++s)
+    {
+        for (uint32_t w = 0; w < s_nWindows; ++w)
+            sums[w] -= getBucket(row, s - s_windows[w]);
+        getBucket(row, s) = 0;
+    }
+    lastSecond = second;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Per-row damage in one second buckets of the encounter clock, a ring covering the longest window, so
+// the memory doesn't grow with the encounter. The damage of each rolling window is kept as a running
+// sum: a bucket leaves it when its row moves to a later second, adding damage is O(1).
+class DamageTimeline
+{
+public:
+    static constexpr uint32_t s_nBuckets = 64; // Power of two, longer than the longest window
+    static constexpr uint32_t s_nWindows = 3;
+    static constexpr std::array<int64_t, s_nWindows> s_windows = {5, 30, 60}; // Seconds, the first one is the burst window
+
+public:
+    DamageTimeline();
+    ~DamageTimeline();
+
+    void reserve(size_t size);
+    void addRow();
+    void clear();
+
+    inline void add(uint32_t row, int64_t second, uint64_t damage);
+
+    // In the window ending at the given second, current bucket included
+    uint64_t getDamage(uint32_t row, uint32_t window, int64_t second) const;
+
+    // Seconds covered by a window at the given second, shorter at the start of the encounter
+    static inline int64_t getWindowTime(uint32_t window, int64_t second);
+
+    // Highest burst window rate so far, never decreases
+    inline double getPeakRate(uint32_t row) const;
+
+private:
+    inline uint64_t &getBucket(uint32_t row, int64_t second);
+    inline uint64_t getBucket(uint32_t row, int64_t second) const;
+
+    void advance(uint32_t row, int64_t second);
+
+private:
+    std::vector<uint64_t> m_buckets; // "s_nBuckets" per row
+    std::vector<int64_t> m_lastSeconds;
+    std::vector<std::array<uint64_t, s_nWindows>> m_sums;
+    std::vector<double> m_peaks;
+};
+
+inline void DamageTimeline::add(uint32_t row, int64_t second, uint64_t damage)
+{
+    if (second > m_lastSeconds[row])
+        advance(row, second);
+
+    // Late damage goes to the current bucket, the windows only move forward
+    getBucket(row, m_lastSeconds[row]) += damage;
+
+    auto &sums = m_sums[row];
+    for (auto &&sum : sums)
+        sum += damage;
+
+    const double rate = static_cast<double>(sums[0]) / getWindowTime(0, m_lastSeconds[row]);
+    if (rate > m_peaks[row])
+        m_peaks[row] = rate;
+}
+
+inline int64_t DamageTimeline::getWindowTime(uint32_t window, int64_t second)
+{
+    return std::min(s_windows[window], second + 1);
+}
+
+inline double DamageTimeline::getPeakRate(uint32_t row) const
+{
+    return m_peaks[row];
+}
+
+inline uint64_t &DamageTimeline::getBucket(uint32_t row, int64_t second)
+{
+    return m_buckets[row * s_nBuckets + (second & (s_nBuckets - 1))];
+}
+inline uint64_t DamageTimeline::getBucket(uint32_t row, int64_t second) const
+{
+    return m_buckets[row * s_nBuckets + (second & (s_nBuckets - 1))];
+}
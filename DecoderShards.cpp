@@ -0,0 +1,364 @@
+#include "DecoderShards.hpp"
+#include "PacketCapture.hpp"
+#include "SpscRing.hpp"
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+constexpr size_t g_packetRingSize = 4096; // Per worker
+constexpr size_t g_eventRingSize = 1 << 14; // Per worker
+constexpr size_t g_maxBatchSize = 256;
+
+namespace {
+
+// Flow tracking and reassembly of the packets hashed to one worker
+class ShardCapture : public PacketCapture
+{
+public:
+    ShardCapture()
+    {
+        setDynamicFilter(false);
+    }
+
+    bool init(uint16_t port) override
+    {
+        m_port = port;
+        return true;
+    }
+
+    inline void process(const uint8_t *packet, qsizetype len, int64_t timestamp)
+    {
+        processPacket(packet, len, timestamp);
+    }
+};
+
+// Both directions of a connection go to the same worker, anything malformed to the first one
+inline uint32_t hashConnection(const uint8_t *packet, qsizetype len)
+{
+    if (len < 20 || (packet[0] >> 4) != 4)
+        return 0;
+
+    const qsizetype ipHeaderSize = (packet[0] & 0x0f) * 4;
+    if (len < ipHeaderSize + 4)
+        return 0;
+
+    uint32_t srcIp, dstIp;
+    uint16_t srcPort, dstPort;
+    memcpy(&srcIp, packet + 12, sizeof(srcIp));
+    memcpy(&dstIp, packet + 16, sizeof(dstIp));
+    memcpy(&srcPort, packet + ipHeaderSize, sizeof(srcPort));
+    memcpy(&dstPort, packet + ipHeaderSize + 2, sizeof(dstPort));
+
+    uint32_t h = (srcIp ^ dstIp) * 0x9e3779b1u;
+    h ^= static_cast<uint32_t>(srcPort ^ dstPort) * 0x85ebca77u;
+    h ^= h >> 15;
+    return h;
+}
+
+}
+
+// Sleeps until notified, notifying a thread which is awake costs one atomic exchange
+class DecoderShards::Wakeup
+{
+public:
+    void notify()
+    {
+        if (m_pending.exchange(true, memory_order_acq_rel))
+            return;
+
+        QMutexLocker locker(&m_mutex);
+        m_condition.wakeOne();
+    }
+
+    void wait()
+    {
+        QMutexLocker locker(&m_mutex);
+        while (!m_pending.exchange(false, memory_order_acq_rel))
+            m_condition.wait(&m_mutex);
+    }
+
+private:
+    std::atomic_bool m_pending {false};
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+};
+
+class DecoderShards::Worker
+{
+public:
+    struct Packet
+    {
+        int64_t timestamp = 0;
+        bool reset = false;
+        std::vector<uint8_t> data; // Keeps its capacity, the ring slots are reused
+    };
+
+public:
+    Worker(DecoderShards &shards)
+        : m_shards(shards)
+    {
+        QObject::connect(&capture, &PacketCapture::newPacket, &decoder, &SWPacketCapture::newPacket, Qt::DirectConnection);
+        QObject::connect(&capture, &PacketCapture::flowReset, &decoder, &SWPacketCapture::resetFlow, Qt::DirectConnection);
+
+        decoder.setEventConsumer([this](const DpsEvent *events, size_t count) {
+            for (size_t i = 0; i < count; ++i)
+            {
+                // The merge thread drains the ring even when it can't deliver yet
+                while (!this->events.push(events[i]))
+                {
+                    if (m_shards.m_stop.load(memory_order_relaxed))
+                        return;
+                    m_shards.m_mergeWakeup->notify();
+                    QThread::yieldCurrentThread();
+                }
+            }
+        });
+    }
+
+    void run()
+    {
+        int64_t lastTimestamp = numeric_limits<int64_t>::min();
+        while (!m_shards.m_stop.load(memory_order_relaxed))
+        {
+            const size_t n = packets.consume([&](Packet &packet) {
+                if (packet.reset)
+                {
+                    capture.reset();
+                    return;
+                }
+                capture.process(packet.data.data(), packet.data.size(), packet.timestamp);
+                lastTimestamp = max(lastTimestamp, packet.timestamp);
+            });
+
+            if (n == 0)
+            {
+                wakeup.wait();
+                continue;
+            }
+
+            watermark.store(lastTimestamp, memory_order_release);
+            m_shards.m_mergeWakeup->notify();
+        }
+    }
+
+public:
+    ShardCapture capture;
+    SWPacketCapture decoder;
+
+    SpscRing<Packet> packets {g_packetRingSize};
+    SpscRing<DpsEvent> events {g_eventRingSize};
+    Wakeup wakeup;
+
+    std::atomic<int64_t> watermark {numeric_limits<int64_t>::min()}; // Of the last decoded batch
+    std::unique_ptr<QThread> thread;
+
+private:
+    DecoderShards &m_shards;
+};
+
+DecoderShards::DecoderShards(uint32_t nWorkers)
+    : m_mergeWakeup(make_unique<Wakeup>())
+{
+    for (uint32_t i = 0; i < max(nWorkers, 1u); ++i)
+        m_workers.push_back(make_unique<Worker>(*this));
+}
+DecoderShards::~DecoderShards()
+{
+    stop();
+}
+
+void DecoderShards::setEventConsumer(const EventConsumer &eventConsumer)
+{
+    m_eventConsumer = eventConsumer;
+}
+
+void DecoderShards::setBlocking(bool blocking)
+{
+    m_blocking = blocking;
+}
+
+void DecoderShards::start(uint16_t port)
+{
+    if (m_mergeThread)
+        return;
+
+    m_stop.store(false, memory_order_relaxed);
+
+    for (uint32_t i = 0; i < m_workers.size(); ++i)
+    {
+        auto worker = m_workers[i].get();
+        worker->capture.init(port);
+        worker->thread.reset(QThread::create([worker] {
+            worker->run();
+        }));
+        worker->thread->setObjectName(QString("DecoderShard%1").arg(i));
+        worker->thread->start();
+    }
+
+    m_mergeThread.reset(QThread::create(bind(&DecoderShards::merge, this)));
+    m_mergeThread->setObjectName("DecoderMerge");
+    m_mergeThread->start();
+}
+
+void DecoderShards::stop()
+{
+    if (!m_mergeThread)
+        return;
+
+    m_stop.store(true, memory_order_relaxed);
+
+    for (auto &&worker : m_workers)
+    {
+        worker->wakeup.notify();
+        worker->thread->wait();
+        worker->thread.reset();
+    }
+
+    m_mergeWakeup->notify();
+    m_mergeThread->wait();
+    m_mergeThread.reset();
+}
+
+void DecoderShards::addPacket(const uint8_t *packet, qsizetype len, int64_t timestamp)
+{
+    auto &worker = *m_workers[hashConnection(packet, len) % m_workers.size()];
+
+    const auto fill = [&](Worker::Packet &slot) {
+        slot.timestamp = timestamp;
+        slot.reset = false;
+        slot.data.assign(packet, packet + len);
+    };
+    while (!worker.packets.produce(fill))
+    {
+        if (!m_blocking)
+        {
+            // Seen by the worker's reassembly as lost data, like a kernel drop
+            m_nDrops.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        worker.wakeup.notify();
+        QThread::yieldCurrentThread();
+    }
+
+    // After the packet is in the ring, see "merge()"
+    if (timestamp > m_dispatched.load(memory_order_relaxed))
+        m_dispatched.store(timestamp, memory_order_release);
+
+    worker.wakeup.notify();
+}
+
+void DecoderShards::reset()
+{
+    for (auto &&worker : m_workers)
+    {
+        while (!worker->packets.produce([](Worker::Packet &slot) { slot.reset = true; }))
+        {
+            worker->wakeup.notify();
+            QThread::yieldCurrentThread();
+        }
+        worker->wakeup.notify();
+    }
+}
+
+void DecoderShards::flush()
+{
+    const auto dispatched = m_dispatched.load(memory_order_relaxed);
+    while (m_mergeThread && m_merged.load(memory_order_acquire) < dispatched)
+    {
+        m_mergeWakeup->notify();
+        QThread::yieldCurrentThread();
+    }
+}
+
+SWPacketCapture *DecoderShards::getDecoder(uint32_t idx) const
+{
+    return &m_workers[idx]->decoder;
+}
+
+uint64_t DecoderShards::getNumPayloadPackets() const
+{
+    uint64_t nPayloadPackets = 0;
+    for (auto &&worker : m_workers)
+        nPayloadPackets += worker->capture.getNumPayloadPackets();
+    return nPayloadPackets;
+}
+
+void DecoderShards::merge()
+{
+    const auto nWorkers = m_workers.size();
+
+    vector<vector<DpsEvent>> pending(nWorkers); // Sorted per worker
+    vector<size_t> pendingPos(nWorkers, 0);
+
+    vector<DpsEvent> batch;
+    batch.reserve(g_maxBatchSize);
+    const auto deliver = [&] {
+        if (!batch.empty() && m_eventConsumer)
+            m_eventConsumer(batch.data(), batch.size());
+        batch.clear();
+    };
+
+    int64_t merged = numeric_limits<int64_t>::min();
+    while (!m_stop.load(memory_order_relaxed))
+    {
+        // Read before the rings: a packet up to this timestamp is either still in a ring or decoded
+        const auto dispatched = m_dispatched.load(memory_order_acquire);
+
+        int64_t watermark = numeric_limits<int64_t>::max();
+        for (auto &&worker : m_workers)
+        {
+            // An empty ring also means its last batch has been decoded, the tail moves after it
+            const bool idle = (worker->packets.size() == 0);
+            const auto workerWatermark = worker->watermark.load(memory_order_acquire);
+            watermark = min(watermark, idle ? max(workerWatermark, dispatched) : workerWatermark);
+        }
+
+        // Events of the batches covered by the watermarks are in the rings now
+        for (size_t i = 0; i < nWorkers; ++i)
+        {
+            m_workers[i]->events.consume([&](const DpsEvent &event) {
+                pending[i].push_back(event);
+            });
+        }
+
+        for (;;)
+        {
+            size_t next = nWorkers;
+            for (size_t i = 0; i < nWorkers; ++i)
+            {
+                if (pendingPos[i] == pending[i].size())
+                    continue;
+                const auto timestamp = pending[i][pendingPos[i]].timestamp;
+                if (timestamp <= watermark && (next == nWorkers || timestamp < pending[next][pendingPos[next]].timestamp))
+                    next = i;
+            }
+            if (next == nWorkers)
+                break;
+
+            batch.push_back(pending[next][pendingPos[next]++]);
+            if (batch.size() == g_maxBatchSize)
+                deliver();
+        }
+        deliver();
+
+        for (size_t i = 0; i < nWorkers; ++i)
+        {
+            pending[i].erase(pending[i].begin(), pending[i].begin() + pendingPos[i]);
+            pendingPos[i] = 0;
+        }
+
+        if (watermark > merged)
+        {
+            merged = watermark;
+            m_merged.store(merged, memory_order_release);
+        }
+
+        m_mergeWakeup->wait();
+    }
+}
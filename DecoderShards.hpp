@@ -0,0 +1,79 @@
+#pragma once
+
+#include "SWPacketCapture.hpp"
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+class QThread;
+
+// Decodes the flows in parallel: packets are hashed by connection to worker threads, each with its own
+// flow table, TCP reassembly and "SWPacketCapture". A merge thread delivers the events of all workers
+// in timestamp order: a worker's watermark is the capture time up to which it has decoded every packet
+// (the latest added one when it is idle), events up to the lowest watermark can't be preceded by any
+// event still to come.
+class DecoderShards
+{
+public:
+    using EventConsumer = SWPacketCapture::EventConsumer;
+
+public:
+    explicit DecoderShards(uint32_t nWorkers);
+    ~DecoderShards();
+
+    // Called from the merge thread, set before "start()"
+    void setEventConsumer(const EventConsumer &eventConsumer);
+
+    // Wait for a busy worker instead of dropping packets, for producers not driven by the kernel
+    void setBlocking(bool blocking);
+
+    void start(uint16_t port); // Server port of the flows to decode
+    void stop();
+
+    // Producer thread only
+    void addPacket(const uint8_t *packet, qsizetype len, int64_t timestamp);
+    void reset(); // Closes the flows of all workers
+    void flush(); // Returns when the events of all packets added so far have been delivered
+
+    inline uint32_t getNumWorkers() const;
+    SWPacketCapture *getDecoder(uint32_t idx) const;
+
+    // Any thread
+    uint64_t getNumPayloadPackets() const;
+    inline uint64_t getNumDrops() const;
+
+private:
+    class Wakeup;
+    class Worker;
+
+    void merge();
+
+private:
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::unique_ptr<QThread> m_mergeThread;
+    std::unique_ptr<Wakeup> m_mergeWakeup;
+
+    EventConsumer m_eventConsumer;
+    bool m_blocking = false;
+    std::atomic_bool m_stop {false};
+
+    std::atomic<int64_t> m_dispatched {std::numeric_limits<int64_t>::min()}; // Latest timestamp added
+    std::atomic<int64_t> m_merged {std::numeric_limits<int64_t>::min()}; // Delivered up to this timestamp
+
+    std::atomic<uint64_t> m_nDrops {0};
+};
+
+inline uint32_t DecoderShards::getNumWorkers() const
+{
+    return m_workers.size();
+}
+
+inline uint64_t DecoderShards::getNumDrops() const
+{
+    return m_nDrops.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+
+constexpr auto g_maxNickLength = 24;
+
+// Decoded game event, trivially copyable so it can be passed between threads
+struct DpsEvent
+{
+    enum class Type : uint8_t
+    {
+        WorldChange,
+        OwnerId,
+        Damage,
+        MazeEnd,
+        PartyMember,
+    };
+
+    struct WorldChange
+    {
+        uint32_t id;
+        uint32_t worldId;
+    };
+    struct OwnerId
+    {
+        uint32_t id;
+        uint32_t ownerId;
+    };
+    struct Damage
+    {
+        uint32_t srcId;
+        uint32_t dstId;
+        uint32_t dmg;
+        uint32_t ssDmg;
+        uint32_t skillId;
+        uint32_t remainHp; // Of the target after the hit
+        uint16_t combo;
+        bool miss;
+        bool crit;
+    };
+    struct PartyMember
+    {
+        uint32_t id;
+        uint8_t characterClass;
+        uint8_t nickLength;
+        char16_t nick[g_maxNickLength];
+    };
+
+    Type type;
+    int64_t timestamp; // Nanoseconds since epoch, capture time of the packet
+    union
+    {
+        WorldChange worldChange;
+        OwnerId ownerId;
+        Damage damage;
+        PartyMember partyMember;
+    };
+};
@@ -1,11 +1,20 @@
 #include "DpsLogic.hpp"
 
 #include <QDebug>
+#include <QTextStream>
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
 
 using namespace std;
 
+constexpr uint32_t g_maxTargets = 64;
+constexpr size_t g_maxHistoryMemoryUsage = 1 << 20;
+
 DpsLogic::DpsLogic(QObject *parent)
     : QObject(parent)
+    , m_targetIndex(g_maxTargets)
 {
     m_timer.setInterval(40);
     connect(&m_timer, &QTimer::timeout,
@@ -21,6 +30,15 @@ DpsLogic::DpsLogic(QObject *parent)
         10051,
         10061,
     };
+
+    m_stats.reserve(64);
+    m_timeline.reserve(64);
+    m_skills.reserve(1024);
+    m_skillHeads.reserve(64);
+    m_targets.resize(g_maxTargets);
+    m_targets.reservePlayers(64);
+    m_ranking.reserve(64);
+    m_ranks.reserve(64);
 }
 DpsLogic::~DpsLogic()
 {
@@ -36,8 +54,9 @@ void DpsLogic::suspend(bool autoResume)
     }
 
     m_timer.stop();
+    m_restartPending = false;
 
-    m_suspendPoint = m_elapsedTimer.nsecsElapsed();
+    m_suspendPoint = getCurrentTime();
     m_suspended = true;
     m_autoResume = autoResume;
 
@@ -50,7 +69,8 @@ void DpsLogic::resume()
 
     m_timer.start();
 
-    m_suspendTime += (m_elapsedTimer.nsecsElapsed() - m_suspendPoint) / 1e9;
+    // Events may carry an earlier time than an extrapolated suspend point
+    m_suspendTime += max<int64_t>(getCurrentTime() - m_suspendPoint, 0) / 1e9;
     m_suspended = false;
 
     m_worldId = m_curWorldId;
@@ -58,9 +78,12 @@ void DpsLogic::resume()
 
 void DpsLogic::reset()
 {
-    m_elapsedTimer.invalidate();
+    archive();
+
     m_timer.stop();
+    m_restartPending = false;
 
+    m_startTime = -1;
     m_suspendTime = 0.0;
     m_suspendPoint = 0;
     m_suspended = false;
@@ -68,7 +91,23 @@ void DpsLogic::reset()
 
     m_worldId = 0;
 
-    m_playerStats.clear();
+    m_statsIndex.clear();
+    m_stats.clear();
+    m_timeline.clear();
+    m_skillNumbers.clear();
+    m_skillIndex.clear();
+    m_skills.clear();
+    m_skillHeads.clear();
+    m_targetIndex.clear();
+    m_targets.clearPlayers();
+    m_ranking.clear();
+    m_ranks.clear();
+    m_totalDamage = 0;
+}
+
+void DpsLogic::setRealTime(bool realTime)
+{
+    m_realTime = realTime;
 }
 
 double DpsLogic::getTime() const
@@ -80,52 +119,164 @@ double DpsLogic::getTime() const
     if (isSuspended())
         time = m_suspendPoint;
     else
-        time = m_elapsedTimer.nsecsElapsed();
-    return time / 1e9 - m_suspendTime;
+        time = getCurrentTime();
+    return (time - m_startTime) / 1e9 - m_suspendTime;
 }
 
-void DpsLogic::iterate(const IterateCallback &cb) const
+void DpsLogic::iterate(const IterateCallback &cb, uint32_t maxPlayers) const
 {
     if (!cb)
         return;
 
-    vector<pair<uint64_t, uint32_t>> dmgPerPlayer;
-    dmgPerPlayer.reserve(m_playerStats.size());
+    const double time = getTime();
 
-    uint64_t totalDamage = 0;
-    for (auto &&[id, playerStats] : m_playerStats)
+    const uint32_t nPlayers = min<size_t>(m_ranking.size(), maxPlayers);
+    for (uint32_t idx = 0; idx < nPlayers; ++idx)
     {
-        dmgPerPlayer.emplace_back(playerStats->damage, id);
-        totalDamage += playerStats->damage;
+        const auto slot = m_ranking[idx];
+        const auto id = m_statsIndex.getId(slot);
+
+        const auto playerSlot = m_playerIndex.find(id);
+        const uint8_t characterClass = (playerSlot != IdIndex::s_noSlot) ? m_playerClasses[playerSlot] : 0;
+
+        auto playerStats = m_stats.get(slot);
+        if (!qIsNaN(time))
+            getRates(slot, time, playerStats);
+
+        cb(idx, getPlayerName(id), characterClass, m_totalDamage, playerStats);
     }
+}
 
-    stable_sort(dmgPerPlayer.begin(), dmgPerPlayer.end(), [](auto &&a, auto &&b) {
-        return (b.first < a.first);
+void DpsLogic::iterateSkills(uint32_t playerId, const SkillCallback &cb) const
+{
+    const auto slot = m_statsIndex.find(playerId);
+    if (!cb || slot == IdIndex::s_noSlot)
+        return;
+
+    vector<uint32_t> rows;
+    for (auto row = m_skillHeads[slot]; row != IdIndex::s_noSlot; row = m_skills.next[row])
+        rows.push_back(row);
+
+    stable_sort(rows.begin(), rows.end(), [this](uint32_t a, uint32_t b) {
+        return (m_skills.damage[a] > m_skills.damage[b]);
     });
 
-    uint32_t idx = 0;
-    for (auto &&dmgPerPlayer : dmgPerPlayer)
+    for (auto row : rows)
+        cb(m_skills.get(row));
+}
+
+void DpsLogic::writeSkills(uint32_t playerId, QTextStream &stream) const
+{
+    vector<SkillStats> skills;
+    uint64_t damage = 0;
+    iterateSkills(playerId, [&](const SkillStats &skillStats) {
+        skills.push_back(skillStats);
+        damage += skillStats.damage;
+    });
+
+    stream << QString("%1 %2 %3 %4 %5 %6 %7\n")
+        .arg("SKILL", -8)
+        .arg("DMG", 14)
+        .arg("DMG%", 6)
+        .arg("HITS", 8)
+        .arg("MAX HIT", 10)
+        .arg("MISS%", 6)
+        .arg("CRIT%", 6)
+    ;
+    for (auto &&skillStats : skills)
     {
-        const auto id = dmgPerPlayer.second;
-        const auto &playerStats = m_playerStats.find(id)->second;
+        const double hits = max<uint64_t>(skillStats.hits, 1);
+        stream << QString("%1 %2 %3 %4 %5 %6 %7\n")
+            .arg(skillStats.skillId, -8)
+            .arg(skillStats.damage, 14)
+            .arg(skillStats.damage * 100.0 / max<uint64_t>(damage, 1), 6, 'f', 1)
+            .arg(skillStats.hits, 8)
+            .arg(skillStats.maxHit, 10)
+            .arg(skillStats.misses * 100.0 / hits, 6, 'f', 1)
+            .arg(skillStats.crits * 100.0 / hits, 6, 'f', 1)
+        ;
+    }
+}
 
-        QString playerName;
-        uint8_t characterClass = 0;
+void DpsLogic::iterateTargets(const TargetCallback &cb) const
+{
+    if (!cb)
+        return;
 
-        const auto it = m_players.find(id);
-        const auto playerFound = (it != m_players.end());
+    for (auto slot = m_targetIndex.getFirst(); slot != LruIndex::s_noSlot; slot = m_targetIndex.getNext(slot))
+    {
+        auto targetStats = m_targets.get(slot);
+        targetStats.targetId = m_targetIndex.getId(slot);
+        cb(targetStats);
+    }
+}
 
-        if (playerFound)
-            characterClass = it->second.second;
+void DpsLogic::iterateTargetPlayers(uint32_t targetId, const TargetPlayerCallback &cb) const
+{
+    const auto slot = m_targetIndex.find(targetId);
+    if (!cb || slot == LruIndex::s_noSlot)
+        return;
 
-        if (id == m_myId)
-            playerName = "[YOU]";
-        else if (playerFound)
-            playerName = it->second.first;
-        else
-            playerName = QString::number(id);
+    for (uint32_t statsSlot = 0; statsSlot < m_stats.damage.size(); ++statsSlot)
+    {
+        if (const auto damage = m_targets.getPlayerDamage(slot, statsSlot); damage > 0)
+            cb(m_statsIndex.getId(statsSlot), damage);
+    }
+}
 
-        cb(idx++, playerName, characterClass, totalDamage, *playerStats);
+bool DpsLogic::getLastTarget(TargetStats &targetStats) const
+{
+    const auto slot = m_targetIndex.getFirst();
+    if (slot == LruIndex::s_noSlot)
+        return false;
+
+    targetStats = m_targets.get(slot);
+    targetStats.targetId = m_targetIndex.getId(slot);
+    return true;
+}
+
+void DpsLogic::ingest(const DpsEvent *events, size_t count)
+{
+    m_deferUpdates = true;
+    for (size_t i = 0; i < count; ++i)
+        processEvent(events[i]);
+    m_deferUpdates = false;
+
+    if (m_updatePending)
+    {
+        m_updatePending = false;
+        doUpdate(exchange(m_restartPending, false));
+    }
+}
+
+void DpsLogic::processEvent(const DpsEvent &event)
+{
+    m_eventTime = event.timestamp;
+    m_eventElapsedTimer.start();
+
+    switch (event.type)
+    {
+        case DpsEvent::Type::WorldChange:
+            worldChange(event.worldChange.id, event.worldChange.worldId);
+            break;
+        case DpsEvent::Type::OwnerId:
+            ownerId(event.ownerId.id, event.ownerId.ownerId);
+            break;
+        case DpsEvent::Type::Damage:
+        {
+            const auto &e = event.damage;
+            damage(e.srcId, e.combo, e.dstId, e.dmg, e.ssDmg, e.skillId, e.remainHp, e.miss, e.crit);
+            break;
+        }
+        case DpsEvent::Type::MazeEnd:
+            mazeEnd();
+            break;
+        case DpsEvent::Type::PartyMember:
+        {
+            const auto &e = event.partyMember;
+            partyMember(e.id, QString::fromUtf16(e.nick, e.nickLength), e.characterClass);
+            break;
+        }
     }
 }
 
@@ -143,16 +294,22 @@ void DpsLogic::worldChange(uint32_t id, uint32_t worldId)
     {
         reset();
         m_worldId = m_curWorldId;
+        emit encounterStarted();
     }
+    m_ownerIndex.clear();
     m_ownerIds.clear();
 
     doUpdate(false);
 }
 void DpsLogic::ownerId(uint32_t id, uint32_t ownerId)
 {
-    m_ownerIds[id] = ownerId;
+    const auto slot = m_ownerIndex.insert(id);
+    if (slot == m_ownerIds.size())
+        m_ownerIds.push_back(ownerId);
+    else
+        m_ownerIds[slot] = ownerId;
 }
-void DpsLogic::damage(uint32_t srcId, uint16_t combo, uint32_t dstId, uint32_t dmg, uint32_t ssDmg, bool miss, bool crit)
+void DpsLogic::damage(uint32_t srcId, uint16_t combo, uint32_t dstId, uint32_t dmg, uint32_t ssDmg, uint32_t skillId, uint32_t remainHp, bool miss, bool crit)
 {
     constexpr uint32_t notPlayerId = 1073741824;
 
@@ -161,8 +318,8 @@ void DpsLogic::damage(uint32_t srcId, uint16_t combo, uint32_t dstId, uint32_t d
 
     bool isDamageFromPlayer = true;
 
-    if (const auto it = m_ownerIds.find(srcId); it != m_ownerIds.end())
-        srcId = it->second;
+    if (const auto slot = m_ownerIndex.find(srcId); slot != IdIndex::s_noSlot)
+        srcId = m_ownerIds[slot];
 
     if (srcId >= notPlayerId)
     {
@@ -173,32 +330,43 @@ void DpsLogic::damage(uint32_t srcId, uint16_t combo, uint32_t dstId, uint32_t d
         isDamageFromPlayer = false;
     }
 
-    auto &playerStats = m_playerStats[srcId];
-    if (!playerStats)
-        playerStats = make_unique<PlayerStats>();
+    const auto slot = getStatsSlot(srcId);
 
     if (isDamageFromPlayer)
     {
-        playerStats->maxCombo = max(playerStats->maxCombo, combo);
+        m_stats.maxCombo[slot] = max(m_stats.maxCombo[slot], combo);
         if (dmg > 0)
         {
-            playerStats->hits += 1;
-            playerStats->damage += dmg;
+            m_stats.hits[slot] += 1;
+            m_stats.damage[slot] += dmg;
+            m_totalDamage += dmg;
+            promote(slot);
             if (miss)
-                playerStats->misses += 1;
+                m_stats.misses[slot] += 1;
             if (crit)
-                playerStats->crits += 1;
+                m_stats.crits[slot] += 1;
             if (ssDmg > 0)
-                playerStats->soulstones += 1;
+                m_stats.soulstones[slot] += 1;
+
+            if (const auto row = getSkillRow(slot, skillId); row != IdIndex::s_noSlot)
+                m_skills.add(row, dmg, miss, crit);
         }
     }
     else
     {
-        playerStats->damageReceived += dmg;
+        m_stats.damageReceived[slot] += dmg;
     }
 
     makeValid();
     resume();
+
+    if (isDamageFromPlayer && dmg > 0)
+    {
+        const double time = getTime();
+        m_timeline.add(slot, max<int64_t>(time, 0), dmg);
+        addTargetDamage(dstId, slot, dmg, remainHp, time);
+    }
+
     doUpdate(true);
 }
 void DpsLogic::mazeEnd()
@@ -207,21 +375,162 @@ void DpsLogic::mazeEnd()
 }
 void DpsLogic::partyMember(uint32_t id, const QString &nick, uint8_t characterClass)
 {
-    auto &player = m_players[id];
+    const auto slot = m_playerIndex.insert(id);
+    if (slot == m_playerNames.size())
+    {
+        m_playerNames.emplace_back();
+        m_playerClasses.push_back(0);
+    }
 
-    if (player.first == nick && player.second == characterClass)
+    if (m_playerNames[slot] == nick && m_playerClasses[slot] == characterClass)
         return;
 
-    player.first = nick;
-    player.second = characterClass <= 8 ? characterClass : 0;
+    m_playerNames[slot] = nick;
+    m_playerClasses[slot] = characterClass <= 8 ? characterClass : 0;
 
     doUpdate(false);
 }
 
+void DpsLogic::archive()
+{
+    if (!isValid() || m_ranking.empty())
+        return;
+
+    auto encounter = make_shared<Encounter>();
+    encounter->m_worldId = getWorldId();
+    encounter->m_time = getTime();
+    encounter->m_totalDamage = m_totalDamage;
+    encounter->m_players.reserve(m_ranking.size());
+    iterate([&](uint32_t idx, const QString &playerName, uint8_t characterClass, uint64_t totalDamage, const PlayerStats &playerStats) {
+        Q_UNUSED(idx)
+        Q_UNUSED(totalDamage)
+        encounter->m_players.push_back({playerName, characterClass, playerStats});
+    });
+
+    m_historyMemoryUsage += encounter->getMemoryUsage();
+    m_history.push_front(move(encounter));
+
+    // The latest one is kept in any case
+    while (m_history.size() > 1 && m_historyMemoryUsage > g_maxHistoryMemoryUsage)
+    {
+        m_historyMemoryUsage -= m_history.back()->getMemoryUsage();
+        m_history.pop_back();
+    }
+}
+
+QString DpsLogic::getPlayerName(uint32_t id) const
+{
+    if (id == m_myId)
+        return "[YOU]";
+
+    const auto playerSlot = m_playerIndex.find(id);
+    if (playerSlot != IdIndex::s_noSlot)
+        return m_playerNames[playerSlot];
+
+    return QString::number(id);
+}
+
+inline uint32_t DpsLogic::getStatsSlot(uint32_t id)
+{
+    const auto slot = m_statsIndex.insert(id);
+    if (slot == m_stats.damage.size())
+    {
+        // No damage yet, after everyone else
+        m_stats.addRow();
+        m_timeline.addRow();
+        m_targets.addPlayer();
+        m_skillHeads.push_back(IdIndex::s_noSlot);
+        m_ranks.push_back(m_ranking.size());
+        m_ranking.push_back(slot);
+    }
+    return slot;
+}
+
+inline void DpsLogic::promote(uint32_t slot)
+{
+    const auto damage = m_stats.damage[slot];
+
+    uint32_t rank = m_ranks[slot];
+    for (; rank > 0; --rank)
+    {
+        const auto prevSlot = m_ranking[rank - 1];
+        const auto prevDamage = m_stats.damage[prevSlot];
+        if (prevDamage > damage || (prevDamage == damage && prevSlot < slot))
+            break;
+
+        m_ranking[rank] = prevSlot;
+        m_ranks[prevSlot] = rank;
+    }
+    m_ranking[rank] = slot;
+    m_ranks[slot] = rank;
+}
+
+inline uint32_t DpsLogic::getSkillRow(uint32_t slot, uint32_t skillId)
+{
+    const auto skillNumber = m_skillNumbers.insert(skillId);
+    if (slot > 0xffff || skillNumber > 0xffff)
+        return IdIndex::s_noSlot; // Out of keys, not seen in practice
+
+    const auto row = m_skillIndex.insert((slot << 16) | skillNumber);
+    if (row == m_skills.damage.size())
+    {
+        m_skills.addRow(skillId, m_skillHeads[slot]);
+        m_skillHeads[slot] = row;
+    }
+    return row;
+}
+
+inline void DpsLogic::addTargetDamage(uint32_t targetId, uint32_t slot, uint32_t dmg, uint32_t remainHp, double time)
+{
+    bool added = false;
+    const auto target = m_targetIndex.touch(targetId, added);
+    if (added)
+        m_targets.reset(target, remainHp, time);
+    m_targets.add(target, slot, dmg, remainHp, time);
+}
+
+void DpsLogic::getRates(uint32_t slot, double time, PlayerStats &playerStats) const
+{
+    const int64_t second = max<int64_t>(time, 0);
+
+    // Windows longer than the encounter so far are divided by the seconds it covers, like the peak
+    const auto rate = [&](uint32_t window) {
+        return static_cast<double>(m_timeline.getDamage(slot, window, second)) / DamageTimeline::getWindowTime(window, second);
+    };
+    playerStats.dps5s = rate(0);
+    playerStats.dps30s = rate(1);
+    playerStats.dps60s = rate(2);
+    playerStats.peakDps = m_timeline.getPeakRate(slot);
+}
+
+int64_t DpsLogic::getCurrentTime() const
+{
+    if (m_realTime && m_eventElapsedTimer.isValid())
+        return m_eventTime + m_eventElapsedTimer.nsecsElapsed();
+    return m_eventTime;
+}
+
 void DpsLogic::doUpdate(bool forceRestart)
 {
+    if (m_deferUpdates)
+    {
+        if (!m_updatePending)
+            m_pendingEventTime = m_eventTime;
+        m_updatePending = true;
+        m_restartPending |= forceRestart;
+        return;
+    }
+
     if (forceRestart || m_timer.isActive())
         m_timer.start();
+
+    if (m_realTime && m_pendingEventTime >= 0)
+    {
+        const int64_t now = chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+        m_latency.add(now - m_pendingEventTime);
+    }
+    m_pendingEventTime = -1;
+
     emit update();
 }
 
@@ -230,7 +539,7 @@ void DpsLogic::makeValid()
     if (isValid())
         return;
 
-    m_elapsedTimer.start();
+    m_startTime = getCurrentTime();
     Q_ASSERT(isValid());
 }
 
@@ -238,3 +547,195 @@ inline bool DpsLogic::isSuspendedCantResume() const
 {
     return (isSuspended() && !isAutoResume());
 }
+
+void DpsLogic::StatsColumns::reserve(size_t size)
+{
+    maxCombo.reserve(size);
+    hits.reserve(size);
+    damage.reserve(size);
+    damageReceived.reserve(size);
+    misses.reserve(size);
+    crits.reserve(size);
+    soulstones.reserve(size);
+}
+void DpsLogic::StatsColumns::addRow()
+{
+    maxCombo.push_back(0);
+    hits.push_back(0);
+    damage.push_back(0);
+    damageReceived.push_back(0);
+    misses.push_back(0);
+    crits.push_back(0);
+    soulstones.push_back(0);
+}
+void DpsLogic::StatsColumns::clear()
+{
+    maxCombo.clear();
+    hits.clear();
+    damage.clear();
+    damageReceived.clear();
+    misses.clear();
+    crits.clear();
+    soulstones.clear();
+}
+
+DpsLogic::PlayerStats DpsLogic::StatsColumns::get(uint32_t slot) const
+{
+    PlayerStats playerStats;
+    playerStats.maxCombo = maxCombo[slot];
+    playerStats.hits = hits[slot];
+    playerStats.damage = damage[slot];
+    playerStats.damageReceived = damageReceived[slot];
+    playerStats.misses = misses[slot];
+    playerStats.crits = crits[slot];
+    playerStats.soulstones = soulstones[slot];
+    return playerStats;
+}
+
+void DpsLogic::SkillColumns::reserve(size_t size)
+{
+    skillIds.reserve(size);
+    hits.reserve(size);
+    damage.reserve(size);
+    misses.reserve(size);
+    crits.reserve(size);
+    maxHits.reserve(size);
+    next.reserve(size);
+}
+void DpsLogic::SkillColumns::addRow(uint32_t skillId, uint32_t nextRow)
+{
+    skillIds.push_back(skillId);
+    hits.push_back(0);
+    damage.push_back(0);
+    misses.push_back(0);
+    crits.push_back(0);
+    maxHits.push_back(0);
+    next.push_back(nextRow);
+}
+void DpsLogic::SkillColumns::clear()
+{
+    skillIds.clear();
+    hits.clear();
+    damage.clear();
+    misses.clear();
+    crits.clear();
+    maxHits.clear();
+    next.clear();
+}
+
+inline void DpsLogic::SkillColumns::add(uint32_t row, uint32_t dmg, bool miss, bool crit)
+{
+    hits[row] += 1;
+    damage[row] += dmg;
+    if (miss)
+        misses[row] += 1;
+    if (crit)
+        crits[row] += 1;
+    maxHits[row] = max(maxHits[row], dmg);
+}
+
+DpsLogic::SkillStats DpsLogic::SkillColumns::get(uint32_t row) const
+{
+    SkillStats skillStats;
+    skillStats.skillId = skillIds[row];
+    skillStats.hits = hits[row];
+    skillStats.damage = damage[row];
+    skillStats.misses = misses[row];
+    skillStats.crits = crits[row];
+    skillStats.maxHit = maxHits[row];
+    return skillStats;
+}
+
+void DpsLogic::TargetColumns::resize(size_t size)
+{
+    damage.resize(size);
+    firstHp.resize(size);
+    hp.resize(size);
+    firstTime.resize(size);
+    lastTime.resize(size);
+    playerDamage.clear();
+}
+void DpsLogic::TargetColumns::reservePlayers(size_t size)
+{
+    playerDamage.reserve(size * damage.size());
+}
+void DpsLogic::TargetColumns::addPlayer()
+{
+    playerDamage.resize(playerDamage.size() + damage.size(), 0);
+}
+void DpsLogic::TargetColumns::clearPlayers()
+{
+    playerDamage.clear();
+}
+void DpsLogic::TargetColumns::reset(uint32_t slot, uint32_t remainHp, double time)
+{
+    damage[slot] = 0;
+    firstHp[slot] = remainHp;
+    hp[slot] = remainHp;
+    firstTime[slot] = time;
+    lastTime[slot] = time;
+    for (size_t i = slot; i < playerDamage.size(); i += damage.size())
+        playerDamage[i] = 0;
+}
+
+inline void DpsLogic::TargetColumns::add(uint32_t slot, uint32_t statsSlot, uint32_t dmg, uint32_t remainHp, double time)
+{
+    damage[slot] += dmg;
+
+    playerDamage[statsSlot * damage.size() + slot] += dmg;
+
+    if (remainHp > hp[slot])
+    {
+        // Healed or respawned with the same id, the loss rate starts over
+        firstHp[slot] = remainHp;
+        firstTime[slot] = time;
+    }
+    hp[slot] = remainHp;
+    lastTime[slot] = time;
+}
+inline uint64_t DpsLogic::TargetColumns::getPlayerDamage(uint32_t slot, uint32_t statsSlot) const
+{
+    return playerDamage[statsSlot * damage.size() + slot];
+}
+
+DpsLogic::TargetStats DpsLogic::TargetColumns::get(uint32_t slot) const
+{
+    TargetStats targetStats;
+    targetStats.damage = damage[slot];
+    targetStats.hp = hp[slot];
+
+    // Over at least a second, the hits of one packet share the time
+    const double elapsed = lastTime[slot] - firstTime[slot];
+    if (elapsed >= 1.0)
+        targetStats.hpLossRate = (firstHp[slot] - hp[slot]) / elapsed;
+
+    if (hp[slot] == 0)
+        targetStats.timeToKill = 0.0;
+    else if (targetStats.hpLossRate > 0.0)
+        targetStats.timeToKill = hp[slot] / targetStats.hpLossRate;
+    else
+        targetStats.timeToKill = qQNaN();
+
+    return targetStats;
+}
+
+void DpsLogic::Encounter::iterate(const IterateCallback &cb, uint32_t maxPlayers) const
+{
+    if (!cb)
+        return;
+
+    const uint32_t nPlayers = min<size_t>(m_players.size(), maxPlayers);
+    for (uint32_t idx = 0; idx < nPlayers; ++idx)
+    {
+        const auto &player = m_players[idx];
+        cb(idx, player.name, player.characterClass, m_totalDamage, player.stats);
+    }
+}
+
+size_t DpsLogic::Encounter::getMemoryUsage() const
+{
+    size_t memoryUsage = sizeof(Encounter) + m_players.capacity() * sizeof(Player);
+    for (auto &&player : m_players)
+        memoryUsage += player.name.capacity() * sizeof(QChar);
+    return memoryUsage;
+}
@@ -1,13 +1,22 @@
 #pragma once
 
+#include "DamageTimeline.hpp"
+#include "DpsEvent.hpp"
+#include "IdIndex.hpp"
+#include "LatencyHistogram.hpp"
+#include "LruIndex.hpp"
+
 #include <QObject>
 #include <QElapsedTimer>
 #include <QTimer>
 
-#include <unordered_map>
+#include <deque>
 #include <unordered_set>
 #include <functional>
 #include <memory>
+#include <vector>
+
+class QTextStream;
 
 class DpsLogic : public QObject
 {
@@ -23,6 +32,31 @@ public:
         uint64_t misses = 0;
         uint64_t crits = 0;
         uint64_t soulstones = 0;
+
+        // Rolling windows of the encounter clock, one second resolution
+        double dps5s = 0.0;
+        double dps30s = 0.0;
+        double dps60s = 0.0;
+        double peakDps = 0.0; // Best 5 s burst
+    };
+
+    struct SkillStats
+    {
+        uint32_t skillId = 0;
+        uint64_t hits = 0;
+        uint64_t damage = 0;
+        uint64_t misses = 0;
+        uint64_t crits = 0;
+        uint32_t maxHit = 0;
+    };
+
+    struct TargetStats
+    {
+        uint32_t targetId = 0;
+        uint64_t damage = 0;
+        uint32_t hp = 0; // Last known
+        double hpLossRate = 0.0; // Per second since the target was first hit, 0 until known
+        double timeToKill = 0.0; // Seconds at the HP loss rate, NaN until known
     };
 
     using IterateCallback = std::function<void(
@@ -32,6 +66,40 @@ public:
         uint64_t totalDamage,
         const PlayerStats &playerStats
     )>;
+    using SkillCallback = std::function<void(const SkillStats &skillStats)>;
+    using TargetCallback = std::function<void(const TargetStats &targetStats)>;
+    using TargetPlayerCallback = std::function<void(uint32_t playerId, uint64_t damage)>;
+
+    // Player statistics of a finished encounter, never modified after it's archived
+    class Encounter
+    {
+    public:
+        inline uint32_t getWorldId() const;
+        inline double getTime() const;
+        inline uint64_t getTotalDamage() const;
+        inline uint32_t getNumPlayers() const;
+
+        void iterate(const IterateCallback &cb, uint32_t maxPlayers = UINT32_MAX) const;
+
+    private:
+        friend class DpsLogic;
+
+        struct Player
+        {
+            QString name;
+            uint8_t characterClass;
+            PlayerStats stats;
+        };
+
+        size_t getMemoryUsage() const;
+
+    private:
+        uint32_t m_worldId = 0;
+        double m_time = 0.0;
+        uint64_t m_totalDamage = 0;
+        std::vector<Player> m_players; // By damage, highest first
+    };
+    using EncounterPtr = std::shared_ptr<const Encounter>;
 
 public:
     DpsLogic(QObject *parent = nullptr);
@@ -46,20 +114,119 @@ public:
 
     void reset();
 
+    // Extrapolate the time between events with the wall clock, disable for deterministic replays
+    void setRealTime(bool realTime);
+
     double getTime() const;
 
+    // Capture timestamp to processed event, live mode only
+    inline const LatencyHistogram &getLatency() const;
+
     inline uint32_t getWorldId() const;
     inline uint32_t getNumPlayers() const;
-    void iterate(const IterateCallback &cb) const;
+    inline uint64_t getTotalDamage() const;
+
+    // Players by damage, highest first, only the first "maxPlayers" of them
+    void iterate(const IterateCallback &cb, uint32_t maxPlayers = UINT32_MAX) const;
+    inline uint32_t getPlayerId(uint32_t idx) const; // Of the player at this position of "iterate()"
+
+    // Skills of a player by damage, highest first, sorted on each call, for on demand views
+    void iterateSkills(uint32_t playerId, const SkillCallback &cb) const;
+    void writeSkills(uint32_t playerId, QTextStream &stream) const; // Table of "iterateSkills()" with damage shares
+
+    // Targets hit by the players, most recently hit first, the least recently hit ones are forgotten
+    void iterateTargets(const TargetCallback &cb) const;
+    void iterateTargetPlayers(uint32_t targetId, const TargetPlayerCallback &cb) const; // Damage of each player
+    bool getLastTarget(TargetStats &targetStats) const; // False if there's none
+
+    // Encounters archived by "reset()", latest first, the oldest ones are dropped beyond a memory budget
+    inline uint32_t getNumEncounters() const;
+    inline EncounterPtr getEncounter(uint32_t idx) const;
 
 public:
+    // Applies a batch of events with a single update at the end
+    void ingest(const DpsEvent *events, size_t count);
+    void processEvent(const DpsEvent &event);
+
     void worldChange(uint32_t id, uint32_t worldId);
     void ownerId(uint32_t id, uint32_t ownerId);
-    void damage(uint32_t srcId, uint16_t combo, uint32_t dstId, uint32_t dmg, uint32_t ssDmg, bool miss, bool crit);
+    void damage(uint32_t srcId, uint16_t combo, uint32_t dstId, uint32_t dmg, uint32_t ssDmg, uint32_t skillId, uint32_t remainHp, bool miss, bool crit);
     void mazeEnd();
     void partyMember(uint32_t id, const QString &nick, uint8_t characterClass);
 
 private:
+    // Player statistics as columns indexed by the slot in "m_statsIndex", rows are reused after a reset
+    struct StatsColumns
+    {
+        std::vector<uint16_t> maxCombo;
+        std::vector<uint64_t> hits;
+        std::vector<uint64_t> damage;
+        std::vector<uint64_t> damageReceived;
+        std::vector<uint64_t> misses;
+        std::vector<uint64_t> crits;
+        std::vector<uint64_t> soulstones;
+
+        void reserve(size_t size);
+        void addRow();
+        void clear();
+
+        PlayerStats get(uint32_t slot) const;
+    };
+
+    // Per player and skill, rows of a player are linked from "m_skillHeads", newest first
+    struct SkillColumns
+    {
+        std::vector<uint32_t> skillIds;
+        std::vector<uint64_t> hits;
+        std::vector<uint64_t> damage;
+        std::vector<uint64_t> misses;
+        std::vector<uint64_t> crits;
+        std::vector<uint32_t> maxHits;
+        std::vector<uint32_t> next;
+
+        void reserve(size_t size);
+        void addRow(uint32_t skillId, uint32_t next);
+        void clear();
+
+        inline void add(uint32_t row, uint32_t dmg, bool miss, bool crit);
+
+        SkillStats get(uint32_t row) const;
+    };
+
+    // Indexed by the slot in "m_targetIndex", a slot is reset when it's taken by another target
+    struct TargetColumns
+    {
+        std::vector<uint64_t> damage;
+        std::vector<uint32_t> firstHp;
+        std::vector<uint32_t> hp;
+        std::vector<double> firstTime;
+        std::vector<double> lastTime;
+        std::vector<uint64_t> playerDamage; // One row of all target slots per stats slot
+
+        void resize(size_t size);
+        void reservePlayers(size_t size);
+        void addPlayer();
+        void clearPlayers();
+        void reset(uint32_t slot, uint32_t remainHp, double time);
+
+        inline void add(uint32_t slot, uint32_t statsSlot, uint32_t dmg, uint32_t remainHp, double time);
+        inline uint64_t getPlayerDamage(uint32_t slot, uint32_t statsSlot) const;
+
+        TargetStats get(uint32_t slot) const;
+    };
+
+private:
+    int64_t getCurrentTime() const;
+
+    void archive();
+
+    QString getPlayerName(uint32_t id) const;
+    inline uint32_t getStatsSlot(uint32_t id);
+    void getRates(uint32_t slot, double time, PlayerStats &playerStats) const;
+    inline void promote(uint32_t slot);
+    inline uint32_t getSkillRow(uint32_t slot, uint32_t skillId);
+    inline void addTargetDamage(uint32_t targetId, uint32_t slot, uint32_t dmg, uint32_t remainHp, double time);
+
     void doUpdate(bool forceRestart);
 
     void makeValid();
@@ -68,11 +235,25 @@ private:
 
 signals:
     void update();
+    void encounterStarted();
 
 private:
-    QElapsedTimer m_elapsedTimer;
     QTimer m_timer;
 
+    // Event clock, nanoseconds since epoch
+    int64_t m_eventTime = 0;
+    QElapsedTimer m_eventElapsedTimer; // Since the last event
+    bool m_realTime = true;
+
+    LatencyHistogram m_latency; // Capture of an event to the "update()" it requested
+
+    // Updates requested while ingesting a batch
+    bool m_deferUpdates = false;
+    bool m_updatePending = false;
+    bool m_restartPending = false;
+    int64_t m_pendingEventTime = -1; // Of the first event which requested one
+
+    int64_t m_startTime = -1;
     double m_suspendTime = 0.0;
     int64_t m_suspendPoint = 0;
     bool m_suspended = false;
@@ -82,16 +263,42 @@ private:
     uint32_t m_curWorldId = 0;
     uint32_t m_worldId = 0;
 
-    std::unordered_map<uint32_t, std::pair<QString, uint8_t>> m_players;
-    std::unordered_map<uint32_t, std::unique_ptr<PlayerStats>> m_playerStats;
-    std::unordered_map<uint32_t, uint32_t> m_ownerIds;
+    IdIndex m_statsIndex;
+    StatsColumns m_stats;
+    DamageTimeline m_timeline; // Same slots
+
+    // Slots by damage, highest first, ties in slot order. Damage only grows, so a hit
+    // moves its player up a few positions at most, no sorting when iterating.
+    std::vector<uint32_t> m_ranking;
+    std::vector<uint32_t> m_ranks; // By slot
+    uint64_t m_totalDamage = 0;
+
+    // Skill ids get a dense number, a player and skill number pair packed in 32 bits is the key of a row
+    IdIndex m_skillNumbers;
+    IdIndex m_skillIndex;
+    SkillColumns m_skills;
+    std::vector<uint32_t> m_skillHeads; // By slot
+
+    LruIndex m_targetIndex;
+    TargetColumns m_targets;
+
+    std::deque<EncounterPtr> m_history;
+    size_t m_historyMemoryUsage = 0;
+
+    // Party members, kept across encounters
+    IdIndex m_playerIndex;
+    std::vector<QString> m_playerNames;
+    std::vector<uint8_t> m_playerClasses;
+
+    IdIndex m_ownerIndex;
+    std::vector<uint32_t> m_ownerIds;
 
     std::unordered_set<uint32_t> m_cityIds;
 };
 
 inline bool DpsLogic::isValid() const
 {
-    return m_elapsedTimer.isValid();
+    return (m_startTime >= 0);
 }
 inline bool DpsLogic::isSuspended() const
 {
@@ -102,11 +309,50 @@ inline bool DpsLogic::isAutoResume() const
     return m_autoResume;
 }
 
+inline const LatencyHistogram &DpsLogic::getLatency() const
+{
+    return m_latency;
+}
+
 inline uint32_t DpsLogic::getWorldId() const
 {
     return (m_worldId == 0) ? m_curWorldId : m_worldId;
 }
 inline uint32_t DpsLogic::getNumPlayers() const
 {
-    return m_playerStats.size();
+    return m_statsIndex.size();
+}
+inline uint64_t DpsLogic::getTotalDamage() const
+{
+    return m_totalDamage;
+}
+inline uint32_t DpsLogic::getPlayerId(uint32_t idx) const
+{
+    return m_statsIndex.getId(m_ranking[idx]);
+}
+
+inline uint32_t DpsLogic::getNumEncounters() const
+{
+    return m_history.size();
+}
+inline DpsLogic::EncounterPtr DpsLogic::getEncounter(uint32_t idx) const
+{
+    return m_history[idx];
+}
+
+inline uint32_t DpsLogic::Encounter::getWorldId() const
+{
+    return m_worldId;
+}
+inline double DpsLogic::Encounter::getTime() const
+{
+    return m_time;
+}
+inline uint64_t DpsLogic::Encounter::getTotalDamage() const
+{
+    return m_totalDamage;
+}
+inline uint32_t DpsLogic::Encounter::getNumPlayers() const
+{
+    return m_players.size();
 }
@@ -0,0 +1,467 @@
+#include "EventLog.hpp"
+
+#include <QtEndian>
+#include <QDebug>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+// Little-endian layout:
+//
+// File header (40 bytes):
+//   magic "MDMEVLOG", uint32 version, uint32 header size,
+//   uint64 index offset (0 until the log is finished), uint32 block count, uint32 reserved, uint64 event count
+// Blocks, each with a 16-byte header:
+//   uint32 size of the encoded events, uint32 event count, int64 timestamp of the first event
+// Index, one 24-byte entry per block:
+//   uint64 block offset, int64 timestamp of the first event, uint64 number of the first event
+//
+// Event: uint8 type (bits 0-3) and flags (bit 4 miss, bit 5 crit), zigzag varint timestamp delta to the
+// previous event of the block, then the fields as varints, nicks as UTF-16 code units
+//
+// Version 2 adds the skill id after the combo of damage events, version 3 the remaining HP of the target
+// after the skill id, fields missing in older logs are read as 0
+
+constexpr char g_magic[8] = {'M', 'D', 'M', 'E', 'V', 'L', 'O', 'G'};
+constexpr uint32_t g_version = 3;
+constexpr uint32_t g_minVersion = 1; // Readable
+
+constexpr uint32_t g_fileHeaderSize = 40;
+constexpr uint32_t g_blockHeaderSize = 16;
+constexpr uint32_t g_indexEntrySize = 24;
+
+constexpr size_t g_maxBlockSize = 64 << 10; // Encoded events, a block is written when exceeded
+constexpr size_t g_maxEventSize = 1 + 10 + 7 * 5 + 2 + g_maxNickLength * sizeof(char16_t);
+
+constexpr uint8_t g_typeMask = 0x0f;
+constexpr uint8_t g_missFlag = 0x10;
+constexpr uint8_t g_critFlag = 0x20;
+
+constexpr size_t g_readBatchSize = 256;
+
+namespace {
+
+inline uint8_t *putVarint(uint8_t *p, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        *p++ = static_cast<uint8_t>(value) | 0x80;
+        value >>= 7;
+    }
+    *p++ = static_cast<uint8_t>(value);
+    return p;
+}
+
+inline bool getVarint(const uint8_t *&p, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+    for (uint32_t shift = 0; shift < 64 && p < end; shift += 7)
+    {
+        const uint8_t b = *p++;
+        value |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+template <typename T>
+inline bool getVarint(const uint8_t *&p, const uint8_t *end, T &value)
+{
+    uint64_t v = 0;
+    if (!getVarint(p, end, v) || v > numeric_limits<T>::max())
+        return false;
+    value = static_cast<T>(v);
+    return true;
+}
+
+inline uint64_t zigZag(int64_t value)
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+inline int64_t unZigZag(uint64_t value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+uint8_t *encode(uint8_t *p, const DpsEvent &event, int64_t timestampDelta)
+{
+    uint8_t tag = static_cast<uint8_t>(event.type);
+    if (event.type == DpsEvent::Type::Damage)
+    {
+        if (event.damage.miss)
+            tag |= g_missFlag;
+        if (event.damage.crit)
+            tag |= g_critFlag;
+    }
+    *p++ = tag;
+    p = putVarint(p, zigZag(timestampDelta));
+
+    switch (event.type)
+    {
+        case DpsEvent::Type::WorldChange:
+            p = putVarint(p, event.worldChange.id);
+            p = putVarint(p, event.worldChange.worldId);
+            break;
+        case DpsEvent::Type::OwnerId:
+            p = putVarint(p, event.ownerId.id);
+            p = putVarint(p, event.ownerId.ownerId);
+            break;
+        case DpsEvent::Type::Damage:
+            p = putVarint(p, event.damage.srcId);
+            p = putVarint(p, event.damage.dstId);
+            p = putVarint(p, event.damage.dmg);
+            p = putVarint(p, event.damage.ssDmg);
+            p = putVarint(p, event.damage.combo);
+            p = putVarint(p, event.damage.skillId);
+            p = putVarint(p, event.damage.remainHp);
+            break;
+        case DpsEvent::Type::MazeEnd:
+            break;
+        case DpsEvent::Type::PartyMember:
+            p = putVarint(p, event.partyMember.id);
+            *p++ = event.partyMember.characterClass;
+            *p++ = event.partyMember.nickLength;
+            for (uint8_t i = 0; i < event.partyMember.nickLength; ++i)
+            {
+                qToLittleEndian<uint16_t>(event.partyMember.nick[i], p);
+                p += sizeof(char16_t);
+            }
+            break;
+    }
+    return p;
+}
+
+bool decode(const uint8_t *&p, const uint8_t *end, DpsEvent &event, int64_t &timestamp, uint32_t version)
+{
+    if (p >= end)
+        return false;
+
+    const uint8_t tag = *p++;
+    if ((tag & g_typeMask) > static_cast<uint8_t>(DpsEvent::Type::PartyMember))
+        return false;
+    event.type = static_cast<DpsEvent::Type>(tag & g_typeMask);
+
+    uint64_t timestampDelta = 0;
+    if (!getVarint(p, end, timestampDelta))
+        return false;
+    timestamp += unZigZag(timestampDelta);
+    event.timestamp = timestamp;
+
+    switch (event.type)
+    {
+        case DpsEvent::Type::WorldChange:
+            return getVarint(p, end, event.worldChange.id)
+                && getVarint(p, end, event.worldChange.worldId);
+        case DpsEvent::Type::OwnerId:
+            return getVarint(p, end, event.ownerId.id)
+                && getVarint(p, end, event.ownerId.ownerId);
+        case DpsEvent::Type::Damage:
+            event.damage.miss = (tag & g_missFlag);
+            event.damage.crit = (tag & g_critFlag);
+            event.damage.skillId = 0;
+            event.damage.remainHp = 0;
+            return getVarint(p, end, event.damage.srcId)
+                && getVarint(p, end, event.damage.dstId)
+                && getVarint(p, end, event.damage.dmg)
+                && getVarint(p, end, event.damage.ssDmg)
+                && getVarint(p, end, event.damage.combo)
+                && (version < 2 || getVarint(p, end, event.damage.skillId))
+                && (version < 3 || getVarint(p, end, event.damage.remainHp));
+        case DpsEvent::Type::MazeEnd:
+            return true;
+        case DpsEvent::Type::PartyMember:
+        {
+            auto &partyMember = event.partyMember;
+            if (!getVarint(p, end, partyMember.id) || end - p < 2)
+                return false;
+            partyMember.characterClass = *p++;
+            partyMember.nickLength = *p++;
+            if (partyMember.nickLength > g_maxNickLength || end - p < partyMember.nickLength * qsizetype(sizeof(char16_t)))
+                return false;
+            for (uint8_t i = 0; i < partyMember.nickLength; ++i)
+            {
+                partyMember.nick[i] = qFromLittleEndian<uint16_t>(p);
+                p += sizeof(char16_t);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void writeFileHeader(uint8_t *p, uint64_t indexOffset, uint32_t nBlocks, uint64_t nEvents)
+{
+    memcpy(p, g_magic, sizeof(g_magic));
+    qToLittleEndian<uint32_t>(g_version, p + 8);
+    qToLittleEndian<uint32_t>(g_fileHeaderSize, p + 12);
+    qToLittleEndian<uint64_t>(indexOffset, p + 16);
+    qToLittleEndian<uint32_t>(nBlocks, p + 24);
+    qToLittleEndian<uint32_t>(0, p + 28);
+    qToLittleEndian<uint64_t>(nEvents, p + 32);
+}
+
+}
+
+/**/
+
+EventLogWriter::EventLogWriter()
+{
+    m_block.reserve(g_maxBlockSize + g_maxEventSize);
+}
+EventLogWriter::~EventLogWriter()
+{
+    if (m_file.isOpen())
+        finish();
+}
+
+bool EventLogWriter::open(const QString &fileName)
+{
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qCritical().noquote() << "Can't create event log:" << m_file.errorString();
+        return false;
+    }
+
+    m_error = false;
+    m_block.clear();
+    m_nBlockEvents = 0;
+    m_index.clear();
+    m_nEvents = 0;
+    m_nBytesWritten = 0;
+
+    uint8_t header[g_fileHeaderSize];
+    writeFileHeader(header, 0, 0, 0);
+    return write(header, sizeof(header));
+}
+
+void EventLogWriter::add(const DpsEvent *events, size_t count)
+{
+    if (!m_file.isOpen())
+        return;
+
+    uint8_t buffer[g_maxEventSize];
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto &event = events[i];
+
+        if (m_nBlockEvents == 0)
+        {
+            m_blockFirstTimestamp = event.timestamp;
+            m_prevTimestamp = event.timestamp;
+        }
+
+        const auto end = encode(buffer, event, event.timestamp - m_prevTimestamp);
+        m_block.insert(m_block.end(), buffer, end);
+        m_prevTimestamp = event.timestamp;
+
+        m_nBlockEvents += 1;
+        m_nEvents += 1;
+
+        if (m_block.size() >= g_maxBlockSize)
+            writeBlock();
+    }
+}
+
+bool EventLogWriter::finish()
+{
+    if (!m_file.isOpen())
+        return false;
+
+    writeBlock();
+
+    const uint64_t indexOffset = m_nBytesWritten;
+    for (auto &&entry : m_index)
+    {
+        uint8_t indexEntry[g_indexEntrySize];
+        qToLittleEndian<uint64_t>(entry.offset, indexEntry);
+        qToLittleEndian<int64_t>(entry.firstTimestamp, indexEntry + 8);
+        qToLittleEndian<uint64_t>(entry.firstEvent, indexEntry + 16);
+        write(indexEntry, sizeof(indexEntry));
+    }
+
+    // The index is valid only once the header points to it
+    uint8_t header[g_fileHeaderSize];
+    writeFileHeader(header, indexOffset, m_index.size(), m_nEvents);
+    if (!m_error && (!m_file.seek(0) || m_file.write(reinterpret_cast<const char *>(header), sizeof(header)) != sizeof(header)))
+        m_error = true;
+
+    m_file.close();
+
+    if (m_error)
+        qCritical() << "Error writing event log:" << m_file.fileName();
+    return !m_error;
+}
+
+void EventLogWriter::writeBlock()
+{
+    if (m_nBlockEvents == 0)
+        return;
+
+    m_index.push_back({m_nBytesWritten, m_blockFirstTimestamp, m_nEvents - m_nBlockEvents});
+
+    uint8_t header[g_blockHeaderSize];
+    qToLittleEndian<uint32_t>(m_block.size(), header);
+    qToLittleEndian<uint32_t>(m_nBlockEvents, header + 4);
+    qToLittleEndian<int64_t>(m_blockFirstTimestamp, header + 8);
+    write(header, sizeof(header));
+    write(m_block.data(), m_block.size());
+
+    m_block.clear();
+    m_nBlockEvents = 0;
+}
+
+bool EventLogWriter::write(const void *data, qint64 size)
+{
+    if (m_error)
+        return false;
+
+    if (m_file.write(reinterpret_cast<const char *>(data), size) != size)
+    {
+        qCritical().noquote() << "Can't write event log:" << m_file.errorString();
+        m_error = true;
+        return false;
+    }
+
+    m_nBytesWritten += size;
+    return true;
+}
+
+/**/
+
+EventLogReader::EventLogReader()
+{
+}
+EventLogReader::~EventLogReader()
+{
+}
+
+bool EventLogReader::open(const QString &fileName)
+{
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+    {
+        qCritical().noquote() << "Can't open event log:" << m_file.errorString();
+        return false;
+    }
+
+    m_size = m_file.size();
+    m_data = (m_size >= g_fileHeaderSize) ? m_file.map(0, m_size) : nullptr;
+    if (!m_data || memcmp(m_data, g_magic, sizeof(g_magic)) != 0)
+    {
+        qCritical() << "Not an event log:" << fileName;
+        return false;
+    }
+
+    m_version = qFromLittleEndian<uint32_t>(m_data + 8);
+    if (m_version < g_minVersion || m_version > g_version)
+    {
+        qCritical() << "Unsupported event log version:" << m_version;
+        return false;
+    }
+
+    const auto indexOffset = qFromLittleEndian<uint64_t>(m_data + 16);
+    const auto nBlocks = qFromLittleEndian<uint32_t>(m_data + 24);
+
+    m_blocks.clear();
+    m_nEvents = 0;
+
+    // No index if the writer didn't finish, the complete blocks are still usable
+    const bool ok = (indexOffset > 0) ? readIndex(indexOffset, nBlocks) : scanBlocks();
+    if (!ok)
+    {
+        qCritical() << "Corrupt event log:" << fileName;
+        return false;
+    }
+
+    return true;
+}
+
+bool EventLogReader::read(const Consumer &consumer, int64_t from) const
+{
+    auto block = upper_bound(m_blocks.begin(), m_blocks.end(), from, [](int64_t timestamp, const Block &block) {
+        return (timestamp < block.firstTimestamp);
+    });
+    if (block != m_blocks.begin())
+        --block;
+
+    DpsEvent events[g_readBatchSize];
+    size_t count = 0;
+
+    for (; block != m_blocks.end(); ++block)
+    {
+        const uint8_t *p = block->data;
+        const uint8_t *end = p + block->size;
+        int64_t timestamp = block->firstTimestamp;
+
+        for (uint32_t i = 0; i < block->nEvents; ++i)
+        {
+            auto &event = events[count];
+            if (!decode(p, end, event, timestamp, m_version))
+            {
+                qCritical() << "Corrupt event log block at offset:" << (block->data - g_blockHeaderSize - m_data);
+                return false;
+            }
+
+            if (timestamp < from)
+                continue;
+
+            if (++count == g_readBatchSize)
+            {
+                consumer(events, count);
+                count = 0;
+            }
+        }
+    }
+
+    if (count > 0)
+        consumer(events, count);
+
+    return true;
+}
+
+bool EventLogReader::readIndex(uint64_t indexOffset, uint32_t nBlocks)
+{
+    if (indexOffset > static_cast<uint64_t>(m_size) || (m_size - indexOffset) / g_indexEntrySize < nBlocks)
+        return false;
+
+    m_blocks.reserve(nBlocks);
+    for (uint32_t i = 0; i < nBlocks; ++i)
+    {
+        const auto offset = qFromLittleEndian<uint64_t>(m_data + indexOffset + i * g_indexEntrySize);
+        if (offset >= indexOffset || !addBlock(offset))
+            return false;
+    }
+    return true;
+}
+
+bool EventLogReader::scanBlocks()
+{
+    uint64_t offset = g_fileHeaderSize;
+    while (addBlock(offset))
+        offset += g_blockHeaderSize + m_blocks.back().size;
+
+    // A partially written block at the end is expected
+    return true;
+}
+
+bool EventLogReader::addBlock(uint64_t offset)
+{
+    if (offset < g_fileHeaderSize || offset + g_blockHeaderSize > static_cast<uint64_t>(m_size))
+        return false;
+
+    Block block;
+    block.data = m_data + offset + g_blockHeaderSize;
+    block.size = qFromLittleEndian<uint32_t>(m_data + offset);
+    block.nEvents = qFromLittleEndian<uint32_t>(m_data + offset + 4);
+    block.firstTimestamp = qFromLittleEndian<int64_t>(m_data + offset + 8);
+    if (block.size > m_size - offset - g_blockHeaderSize)
+        return false;
+
+    m_blocks.push_back(block);
+    m_nEvents += block.nEvents;
+    return true;
+}
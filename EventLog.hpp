@@ -0,0 +1,113 @@
+#pragma once
+
+#include "DpsEvent.hpp"
+
+#include <QFile>
+
+#include <functional>
+#include <limits>
+#include <vector>
+
+// Compact binary log of decoded events, so sessions can be aggregated again without the raw traffic.
+// Events are stored in independently decodable blocks with delta timestamps and varint fields,
+// an index of the blocks at the end of the file allows skipping to a point in time.
+
+class EventLogWriter
+{
+public:
+    EventLogWriter();
+    ~EventLogWriter();
+
+    bool open(const QString &fileName);
+
+    void add(const DpsEvent *events, size_t count);
+
+    // Writes the last block and the index, a log which was not finished is still readable
+    bool finish();
+
+    inline uint64_t getNumEvents() const;
+    inline uint64_t getNumBytesWritten() const;
+
+private:
+    struct IndexEntry
+    {
+        uint64_t offset;
+        int64_t firstTimestamp;
+        uint64_t firstEvent;
+    };
+
+    void writeBlock();
+    bool write(const void *data, qint64 size);
+
+private:
+    QFile m_file;
+    bool m_error = false;
+
+    std::vector<uint8_t> m_block; // Encoded events of the current block
+    uint32_t m_nBlockEvents = 0;
+    int64_t m_blockFirstTimestamp = 0;
+    int64_t m_prevTimestamp = 0;
+
+    std::vector<IndexEntry> m_index;
+    uint64_t m_nEvents = 0;
+    uint64_t m_nBytesWritten = 0;
+};
+
+class EventLogReader
+{
+public:
+    using Consumer = std::function<void(const DpsEvent *events, size_t count)>;
+
+public:
+    EventLogReader();
+    ~EventLogReader();
+
+    // Maps the file, works for logs which were not finished too
+    bool open(const QString &fileName);
+
+    inline uint64_t getNumEvents() const;
+    inline int64_t getFirstTimestamp() const;
+
+    // Events in batches, starting with the block containing "from", false if the log is corrupt
+    bool read(const Consumer &consumer, int64_t from = std::numeric_limits<int64_t>::min()) const;
+
+private:
+    struct Block
+    {
+        const uint8_t *data;
+        uint32_t size;
+        uint32_t nEvents;
+        int64_t firstTimestamp;
+    };
+
+    bool readIndex(uint64_t indexOffset, uint32_t nBlocks);
+    bool scanBlocks();
+    bool addBlock(uint64_t offset);
+
+private:
+    QFile m_file;
+    const uint8_t *m_data = nullptr;
+    qint64 m_size = 0;
+    uint32_t m_version = 0;
+
+    std::vector<Block> m_blocks;
+    uint64_t m_nEvents = 0;
+};
+
+inline uint64_t EventLogWriter::getNumEvents() const
+{
+    return m_nEvents;
+}
+inline uint64_t EventLogWriter::getNumBytesWritten() const
+{
+    return m_nBytesWritten;
+}
+
+inline uint64_t EventLogReader::getNumEvents() const
+{
+    return m_nEvents;
+}
+inline int64_t EventLogReader::getFirstTimestamp() const
+{
+    return m_blocks.empty() ? 0 : m_blocks.front().firstTimestamp;
+}
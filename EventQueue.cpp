@@ -0,0 +1,84 @@
+#include "EventQueue.hpp"
+
+#include <QThread>
+#include <QDebug>
+
+using namespace std;
+
+EventQueue::EventQueue(size_t capacity, QObject *parent)
+    : QObject(parent)
+    , m_ring(capacity)
+{
+}
+EventQueue::~EventQueue()
+{
+}
+
+void EventQueue::setConsumer(const Consumer &consumer)
+{
+    m_consumer = consumer;
+}
+
+void EventQueue::setBlocking(bool blocking)
+{
+    m_blocking = blocking;
+}
+
+void EventQueue::push(const DpsEvent *events, size_t count)
+{
+    m_nEvents.fetch_add(count, memory_order_relaxed);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        while (!m_ring.push(events[i]))
+        {
+            if (!m_blocking)
+            {
+                m_nOverflows.fetch_add(1, memory_order_relaxed);
+                break;
+            }
+            wakeConsumer();
+            QThread::yieldCurrentThread();
+        }
+    }
+
+    const auto occupancy = m_ring.size();
+    if (occupancy > m_maxOccupancy.load(memory_order_relaxed))
+        m_maxOccupancy.store(occupancy, memory_order_relaxed);
+
+    // Wake up the consumer once per batch, not once per event
+    wakeConsumer();
+}
+
+void EventQueue::wakeConsumer()
+{
+    if (!m_drainPending.load(memory_order_relaxed) && !m_drainPending.exchange(true, memory_order_acq_rel))
+        QMetaObject::invokeMethod(this, &EventQueue::drain, Qt::QueuedConnection);
+}
+
+void EventQueue::drain()
+{
+    m_drainPending.store(false, memory_order_release);
+
+    // Hand over in batches, so the consumer updates once per batch
+    constexpr size_t maxBatchSize = 256;
+    DpsEvent events[maxBatchSize];
+    for (;;)
+    {
+        size_t count = 0;
+        while (count < maxBatchSize && m_ring.pop(events[count]))
+            ++count;
+        if (count == 0)
+            break;
+
+        if (m_consumer)
+            m_consumer(events, count);
+    }
+
+    const auto nOverflows = getNumOverflows();
+    if (nOverflows != m_nOverflowsReported)
+    {
+        qWarning() << "Event queue overflow, dropped events:" << nOverflows - m_nOverflowsReported;
+        m_nOverflowsReported = nOverflows;
+    }
+}
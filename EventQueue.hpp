@@ -0,0 +1,73 @@
+#pragma once
+
+#include "DpsEvent.hpp"
+#include "SpscRing.hpp"
+
+#include <QObject>
+
+#include <functional>
+
+// Hands decoded events from the capture thread to the GUI thread
+class EventQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Consumer = std::function<void(const DpsEvent *events, size_t count)>;
+
+public:
+    EventQueue(size_t capacity, QObject *parent = nullptr);
+    ~EventQueue();
+
+    void setConsumer(const Consumer &consumer);
+
+    // Wait for free space instead of dropping events, for producers not driven by the kernel
+    void setBlocking(bool blocking);
+
+    // Producer thread only, events are dropped when queue is full and not blocking
+    void push(const DpsEvent *events, size_t count);
+
+    // Any thread
+    inline size_t getCapacity() const;
+    inline size_t getOccupancy() const;
+    inline size_t getMaxOccupancy() const;
+    inline uint64_t getNumEvents() const;
+    inline uint64_t getNumOverflows() const;
+
+private:
+    void wakeConsumer();
+    void drain();
+
+private:
+    SpscRing<DpsEvent> m_ring;
+    Consumer m_consumer;
+    bool m_blocking = false;
+
+    std::atomic_bool m_drainPending {false};
+
+    std::atomic<size_t> m_maxOccupancy {0};
+    std::atomic<uint64_t> m_nEvents {0};
+    std::atomic<uint64_t> m_nOverflows {0};
+    uint64_t m_nOverflowsReported = 0;
+};
+
+inline size_t EventQueue::getCapacity() const
+{
+    return m_ring.capacity();
+}
+inline size_t EventQueue::getOccupancy() const
+{
+    return m_ring.size();
+}
+inline size_t EventQueue::getMaxOccupancy() const
+{
+    return m_maxOccupancy.load(std::memory_order_relaxed);
+}
+inline uint64_t EventQueue::getNumEvents() const
+{
+    return m_nEvents.load(std::memory_order_relaxed);
+}
+inline uint64_t EventQueue::getNumOverflows() const
+{
+    return m_nOverflows.load(std::memory_order_relaxed);
+}
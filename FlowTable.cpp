@@ -0,0 +1,118 @@
+#include "FlowTable.hpp"
+
+using namespace std;
+
+FlowTable::FlowTable()
+{
+}
+FlowTable::~FlowTable()
+{
+}
+
+void FlowTable::setRemoveCallback(const RemoveCallback &removeCallback)
+{
+    m_removeCallback = removeCallback;
+}
+
+FlowTable::Flow &FlowTable::insert(const FlowKey &key, int64_t time)
+{
+    if (m_size == s_maxFlows)
+    {
+        Flow *oldest = nullptr;
+        forEach([&](const Flow &flow) {
+            if (!oldest || flow.lastSeen < oldest->lastSeen)
+                oldest = const_cast<Flow *>(&flow);
+        });
+        remove(*oldest);
+    }
+
+    uint32_t id = 0;
+    while (m_usedMask & (1u << id))
+        ++id;
+
+    auto &flow = m_flows[id];
+    flow.key = key;
+    flow.hash = key.hash();
+    flow.lastSeen = time;
+    flow.reassembly.reset(0);
+
+    uint32_t i = flow.hash & s_indexMask;
+    while (m_index[i] != 0)
+        i = (i + 1) & s_indexMask;
+    m_index[i] = id + 1;
+
+    m_usedMask |= (1u << id);
+    m_size += 1;
+
+    m_lastFlow = &flow;
+    return flow;
+}
+
+void FlowTable::remove(Flow &flow)
+{
+    const uint32_t id = getId(flow);
+
+    uint32_t i = flow.hash & s_indexMask;
+    while (m_index[i] != id + 1)
+        i = (i + 1) & s_indexMask;
+
+    // Backward shift deletion, keeps probe sequences intact without tombstones
+    m_index[i] = 0;
+    for (uint32_t j = (i + 1) & s_indexMask; m_index[j] != 0; j = (j + 1) & s_indexMask)
+    {
+        const uint32_t home = m_flows[m_index[j] - 1].hash & s_indexMask;
+        const bool canMove = (i <= j)
+            ? (home <= i || home > j)
+            : (home <= i && home > j)
+        ;
+        if (canMove)
+        {
+            m_index[i] = m_index[j];
+            m_index[j] = 0;
+            i = j;
+        }
+    }
+
+    flow.reassembly.release();
+
+    m_usedMask &= ~(1u << id);
+    m_size -= 1;
+
+    if (m_lastFlow == &flow)
+        m_lastFlow = nullptr;
+
+    if (m_removeCallback)
+        m_removeCallback(id);
+}
+
+void FlowTable::removeIdle(int64_t time, int64_t timeout)
+{
+    for (uint32_t id = 0; id < s_maxFlows; ++id)
+    {
+        if ((m_usedMask & (1u << id)) && time - m_flows[id].lastSeen > timeout)
+            remove(m_flows[id]);
+    }
+}
+
+void FlowTable::clear()
+{
+    for (uint32_t id = 0; id < s_maxFlows; ++id)
+    {
+        if (m_usedMask & (1u << id))
+            remove(m_flows[id]);
+    }
+}
+
+FlowTable::Flow *FlowTable::probe(const FlowKey &key, uint32_t hash)
+{
+    for (uint32_t i = hash & s_indexMask; m_index[i] != 0; i = (i + 1) & s_indexMask)
+    {
+        auto &flow = m_flows[m_index[i] - 1];
+        if (flow.hash == hash && flow.key == key)
+        {
+            m_lastFlow = &flow;
+            return &flow;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "TcpReassembly.hpp"
+
+#include <functional>
+#include <cstdint>
+#include <vector>
+#include <array>
+
+struct FlowKey
+{
+    uint32_t srcIp = 0;
+    uint32_t dstIp = 0;
+    uint16_t srcPort = 0;
+    uint16_t dstPort = 0;
+
+    inline bool operator==(const FlowKey &other) const;
+    inline uint32_t hash() const;
+};
+
+// Fixed-size open addressing table of TCP flows, flow id stays valid until the flow is removed
+class FlowTable
+{
+public:
+    static constexpr uint32_t s_maxFlows = 32;
+
+    struct Flow
+    {
+        FlowKey key;
+        uint32_t hash = 0;
+        int64_t lastSeen = 0;
+
+        TcpReassembly reassembly;
+    };
+
+    using RemoveCallback = std::function<void(uint32_t flowId)>;
+
+public:
+    FlowTable();
+    ~FlowTable();
+
+    void setRemoveCallback(const RemoveCallback &removeCallback);
+
+    inline uint32_t size() const;
+    inline uint32_t getId(const Flow &flow) const;
+
+    inline Flow *find(const FlowKey &key);
+
+    Flow &insert(const FlowKey &key, int64_t time); // Key must not exist, evicts least recently used flow when full
+    void remove(Flow &flow);
+    void removeIdle(int64_t time, int64_t timeout);
+    void clear();
+
+    template <typename Fn>
+    inline void forEach(Fn &&fn) const;
+
+private:
+    Flow *probe(const FlowKey &key, uint32_t hash);
+
+private:
+    static constexpr uint32_t s_indexSize = s_maxFlows * 2;
+    static constexpr uint32_t s_indexMask = s_indexSize - 1;
+    static_assert((s_indexSize & s_indexMask) == 0);
+
+    std::array<Flow, s_maxFlows> m_flows;
+    std::array<uint8_t, s_indexSize> m_index = {}; // Flow id + 1, 0 = empty
+    uint32_t m_usedMask = 0;
+    static_assert(s_maxFlows <= sizeof(m_usedMask) * 8);
+    uint32_t m_size = 0;
+
+    Flow *m_lastFlow = nullptr;
+
+    RemoveCallback m_removeCallback;
+};
+
+inline bool FlowKey::operator==(const FlowKey &other) const
+{
+    return (srcIp == other.srcIp && dstIp == other.dstIp && srcPort == other.srcPort && dstPort == other.dstPort);
+}
+inline uint32_t FlowKey::hash() const
+{
+    uint32_t h = srcIp * 0x9e3779b1u;
+    h ^= dstIp * 0x85ebca77u;
+    h ^= ((static_cast<uint32_t>(srcPort) << 16) | dstPort) * 0xc2b2ae3du;
+    h ^= h >> 15;
+    return h;
+}
+
+inline uint32_t FlowTable::size() const
+{
+    return m_size;
+}
+inline uint32_t FlowTable::getId(const Flow &flow) const
+{
+    return &flow - m_flows.data();
+}
+
+inline FlowTable::Flow *FlowTable::find(const FlowKey &key)
+{
+    // Almost all packets belong to the same flow as the previous one
+    if (m_lastFlow && m_lastFlow->key == key)
+        return m_lastFlow;
+    return probe(key, key.hash());
+}
+
+template <typename Fn>
+inline void FlowTable::forEach(Fn &&fn) const
+{
+    for (uint32_t i = 0; i < s_maxFlows; ++i)
+    {
+        if (m_usedMask & (1u << i))
+            fn(m_flows[i]);
+    }
+}
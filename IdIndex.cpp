@@ -0,0 +1,38 @@
+#include "IdIndex.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+constexpr uint32_t g_initialSize = 64;
+
+IdIndex::IdIndex()
+    : m_entries(g_initialSize, {0, s_noSlot})
+    , m_mask(g_initialSize - 1)
+{
+    m_ids.reserve(g_initialSize / 2);
+}
+IdIndex::~IdIndex()
+{
+}
+
+void IdIndex::clear()
+{
+    fill(m_entries.begin(), m_entries.end(), Entry {0, s_noSlot});
+    m_ids.clear();
+}
+
+void IdIndex::grow()
+{
+    const uint32_t size = m_entries.size() * 2;
+    m_entries.assign(size, {0, s_noSlot});
+    m_mask = size - 1;
+
+    for (uint32_t slot = 0; slot < m_ids.size(); ++slot)
+    {
+        uint32_t i = hash(m_ids[slot]) & m_mask;
+        while (m_entries[i].slot != s_noSlot)
+            i = (i + 1) & m_mask;
+        m_entries[i] = {m_ids[slot], slot};
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Open addressing map from game object id to a dense slot, for data kept in arrays indexed by the slot.
+// Slots are handed out in insertion order, "clear()" keeps the memory, so refilling doesn't allocate.
+class IdIndex
+{
+public:
+    static constexpr uint32_t s_noSlot = UINT32_MAX;
+
+public:
+    IdIndex();
+    ~IdIndex();
+
+    inline uint32_t size() const;
+    inline uint32_t getId(uint32_t slot) const;
+
+    inline uint32_t find(uint32_t id) const; // "s_noSlot" when not found
+    inline uint32_t insert(uint32_t id); // Existing slot, or "size() - 1" after adding the id
+
+    void clear();
+
+    static inline uint32_t hash(uint32_t id);
+
+private:
+    struct Entry
+    {
+        uint32_t id;
+        uint32_t slot; // "s_noSlot" when empty
+    };
+
+    void grow();
+
+private:
+    std::vector<Entry> m_entries; // Power of two, at most half full
+    uint32_t m_mask = 0;
+    std::vector<uint32_t> m_ids; // By slot
+};
+
+inline uint32_t IdIndex::size() const
+{
+    return m_ids.size();
+}
+inline uint32_t IdIndex::getId(uint32_t slot) const
+{
+    return m_ids[slot];
+}
+
+inline uint32_t IdIndex::find(uint32_t id) const
+{
+    for (uint32_t i = hash(id) & m_mask; ; i = (i + 1) & m_mask)
+    {
+        const auto &entry = m_entries[i];
+        if (entry.slot == s_noSlot || entry.id == id)
+            return entry.slot;
+    }
+}
+
+inline uint32_t IdIndex::insert(uint32_t id)
+{
+    uint32_t i = hash(id) & m_mask;
+    for (; m_entries[i].slot != s_noSlot; i = (i + 1) & m_mask)
+    {
+        if (m_entries[i].id == id)
+            return m_entries[i].slot;
+    }
+
+    const uint32_t slot = m_ids.size();
+    m_entries[i] = {id, slot};
+    m_ids.push_back(id);
+
+    if (m_ids.size() * 2 > m_entries.size())
+        grow();
+
+    return slot;
+}
+
+inline uint32_t IdIndex::hash(uint32_t id)
+{
+    uint32_t h = id * 0x9e3779b1u;
+    h ^= h >> 16;
+    return h;
+}
@@ -0,0 +1,56 @@
+#include "LatencyHistogram.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+LatencyHistogram::LatencyHistogram()
+{
+}
+LatencyHistogram::~LatencyHistogram()
+{
+}
+
+void LatencyHistogram::reset()
+{
+    m_buckets = {};
+    m_nSamples = 0;
+    m_sum = 0;
+    m_max = 0;
+}
+
+void LatencyHistogram::add(int64_t latency)
+{
+    // Clock steps can make it negative
+    latency = max<int64_t>(latency, 0);
+
+    uint64_t us = static_cast<uint64_t>(latency) / 1'000;
+    uint32_t bucket = 0;
+    while (us > 0 && bucket < s_nBuckets - 1)
+    {
+        us >>= 1;
+        ++bucket;
+    }
+
+    m_buckets[bucket] += 1;
+    m_nSamples += 1;
+    m_sum += latency;
+    m_max = max(m_max, latency);
+}
+
+int64_t LatencyHistogram::getPercentile(double fraction) const
+{
+    if (m_nSamples == 0)
+        return 0;
+
+    const uint64_t rank = max<uint64_t>(fraction * m_nSamples, 1);
+
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < s_nBuckets; ++i)
+    {
+        count += m_buckets[i];
+        if (count >= rank)
+            return min<int64_t>((1ll << i) * 1'000, m_max);
+    }
+    return m_max;
+}
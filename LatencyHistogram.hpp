@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Power of two buckets in microseconds, cheap enough to record every event
+class LatencyHistogram
+{
+public:
+    static constexpr uint32_t s_nBuckets = 32;
+
+public:
+    LatencyHistogram();
+    ~LatencyHistogram();
+
+    void reset();
+
+    void add(int64_t latency); // ns
+
+    // Upper bound of the bucket containing the given fraction of samples, ns
+    int64_t getPercentile(double fraction) const;
+
+    inline uint64_t getNumSamples() const;
+    inline int64_t getMax() const;
+    inline double getMean() const;
+
+private:
+    std::array<uint64_t, s_nBuckets> m_buckets = {};
+    uint64_t m_nSamples = 0;
+    int64_t m_sum = 0;
+    int64_t m_max = 0;
+};
+
+inline uint64_t LatencyHistogram::getNumSamples() const
+{
+    return m_nSamples;
+}
+inline int64_t LatencyHistogram::getMax() const
+{
+    return m_max;
+}
+inline double LatencyHistogram::getMean() const
+{
+    return (m_nSamples > 0) ? static_cast<double>(m_sum) / m_nSamples : 0.0;
+}
@@ -0,0 +1,98 @@
+#include "LruIndex.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+LruIndex::LruIndex(uint32_t capacity)
+    : m_ids(max(capacity, 1u))
+    , m_prev(m_ids.size())
+    , m_next(m_ids.size())
+{
+    uint32_t size = 1;
+    while (size < m_ids.size() * 2)
+        size *= 2;
+    m_entries.assign(size, {0, s_noSlot});
+    m_mask = size - 1;
+}
+LruIndex::~LruIndex()
+{
+}
+
+void LruIndex::clear()
+{
+    fill(m_entries.begin(), m_entries.end(), Entry {0, s_noSlot});
+    m_size = 0;
+    m_first = s_noSlot;
+    m_last = s_noSlot;
+}
+
+uint32_t LruIndex::add(uint32_t id)
+{
+    uint32_t slot;
+    if (m_size < m_ids.size())
+    {
+        slot = m_size++;
+    }
+    else
+    {
+        slot = m_last;
+        erase(m_ids[slot]);
+        unlink(slot);
+    }
+
+    m_entries[findEntry(id)] = {id, slot};
+    m_ids[slot] = id;
+
+    m_prev[slot] = s_noSlot;
+    m_next[slot] = m_first;
+    if (m_first != s_noSlot)
+        m_prev[m_first] = slot;
+    else
+        m_last = slot;
+    m_first = slot;
+
+    return slot;
+}
+
+void LruIndex::moveToFront(uint32_t slot)
+{
+    unlink(slot);
+
+    m_prev[slot] = s_noSlot;
+    m_next[slot] = m_first;
+    m_prev[m_first] = slot;
+    m_first = slot;
+}
+
+void LruIndex::unlink(uint32_t slot)
+{
+    const auto prev = m_prev[slot];
+    const auto next = m_next[slot];
+
+    if (prev != s_noSlot)
+        m_next[prev] = next;
+    else
+        m_first = next;
+
+    if (next != s_noSlot)
+        m_prev[next] = prev;
+    else
+        m_last = prev;
+}
+
+void LruIndex::erase(uint32_t id)
+{
+    // Backward shift: entries after the hole move into it unless their home is cyclically after the hole
+    uint32_t hole = findEntry(id);
+    for (uint32_t i = (hole + 1) & m_mask; m_entries[i].slot != s_noSlot; i = (i + 1) & m_mask)
+    {
+        const uint32_t home = IdIndex::hash(m_entries[i].id) & m_mask;
+        if (((i - home) & m_mask) >= ((i - hole) & m_mask))
+        {
+            m_entries[hole] = m_entries[i];
+            hole = i;
+        }
+    }
+    m_entries[hole].slot = s_noSlot;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "IdIndex.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Fixed capacity map from game object id to a slot, like "IdIndex", for objects which come and go. Once
+// full, a new id takes the slot of the least recently used one, so data indexed by the slot stays bounded.
+class LruIndex
+{
+public:
+    static constexpr uint32_t s_noSlot = UINT32_MAX;
+
+public:
+    explicit LruIndex(uint32_t capacity);
+    ~LruIndex();
+
+    inline uint32_t size() const;
+    inline uint32_t getCapacity() const;
+    inline uint32_t getId(uint32_t slot) const;
+
+    inline uint32_t find(uint32_t id) const; // "s_noSlot" when not found
+
+    // Slot of the id, which becomes the most recently used one, "added" is set when the slot is new to it
+    inline uint32_t touch(uint32_t id, bool &added);
+
+    // Most recently used first, "s_noSlot" at the end
+    inline uint32_t getFirst() const;
+    inline uint32_t getNext(uint32_t slot) const;
+
+    void clear();
+
+private:
+    struct Entry
+    {
+        uint32_t id;
+        uint32_t slot; // "s_noSlot" when empty
+    };
+
+    inline uint32_t findEntry(uint32_t id) const;
+
+    uint32_t add(uint32_t id);
+    void moveToFront(uint32_t slot);
+    void unlink(uint32_t slot);
+    void erase(uint32_t id);
+
+private:
+    std::vector<Entry> m_entries; // Power of two, at most half full
+    uint32_t m_mask = 0;
+
+    // By slot
+    std::vector<uint32_t> m_ids;
+    std::vector<uint32_t> m_prev;
+    std::vector<uint32_t> m_next;
+
+    uint32_t m_size = 0;
+    uint32_t m_first = s_noSlot;
+    uint32_t m_last = s_noSlot;
+};
+
+inline uint32_t LruIndex::size() const
+{
+    return m_size;
+}
+inline uint32_t LruIndex::getCapacity() const
+{
+    return m_ids.size();
+}
+inline uint32_t LruIndex::getId(uint32_t slot) const
+{
+    return m_ids[slot];
+}
+
+inline uint32_t LruIndex::find(uint32_t id) const
+{
+    return m_entries[findEntry(id)].slot;
+}
+
+inline uint32_t LruIndex::touch(uint32_t id, bool &added)
+{
+    const auto slot = find(id);
+    added = (slot == s_noSlot);
+    if (added)
+        return add(id);
+    if (slot != m_first)
+        moveToFront(slot);
+    return slot;
+}
+
+inline uint32_t LruIndex::getFirst() const
+{
+    return m_first;
+}
+inline uint32_t LruIndex::getNext(uint32_t slot) const
+{
+    return m_next[slot];
+}
+
+inline uint32_t LruIndex::findEntry(uint32_t id) const
+{
+    uint32_t i = IdIndex::hash(id) & m_mask;
+    while (m_entries[i].slot != s_noSlot && m_entries[i].id != id)
+        i = (i + 1) & m_mask;
+    return i;
+}
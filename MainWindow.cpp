@@ -1,5 +1,6 @@
 #include "MainWindow.hpp"
 #include "TitleBar.hpp"
+#include "SkillsDialog.hpp"
 #include "DpsLogic.hpp"
 
 #include <QGuiApplication>
@@ -18,7 +19,7 @@
 
 using namespace std;
 
-constexpr auto g_nCols = 10;
+constexpr auto g_nCols = 12;
 
 class ItemDelegate : public QItemDelegate
 {
@@ -53,6 +54,8 @@ MainWindow::MainWindow(DpsLogic &dpsLogic)
     const QStringList labels {
         tr("NAME"),
         tr("DPS"),
+        tr("DPS 5s"),
+        tr("PEAK"),
         tr("DMG%"),
         tr("DMG"),
         tr("DMG RCV"),
@@ -81,7 +84,10 @@ MainWindow::MainWindow(DpsLogic &dpsLogic)
     auto suspendAction = menu->addAction(tr("Suspend"));
     auto resumeAction = menu->addAction(tr("Resume"));
     auto resetAction = menu->addAction(tr("Reset"));
+    auto historyMenu = menu->addMenu(tr("History"));
     menu->addSeparator();
+    menu->addAction(tr("Statistics"), this, &MainWindow::statisticsRequested);
+    menu->addAction(tr("Protocol profile"), this, &MainWindow::profileRequested);
     menu->addAction(tr("Close"), this, &MainWindow::close);
 
     m_players->setItemDelegate(new ItemDelegate);
@@ -105,9 +111,9 @@ MainWindow::MainWindow(DpsLogic &dpsLogic)
         horizontalHeader->resizeSection(logicalIdx, max<int>(minContentWidth, labels[logicalIdx].length() * fontMaxWidth) + 8);
     };
     setFixedColumnWidth(0, minNameWidth);
-    setFixedColumnWidth(5, minHitPerSecWidth);
-    setFixedColumnWidth(6, minComboWidth);
-    for (int logicalIdx : {2, 7, 8, 9})
+    setFixedColumnWidth(7, minHitPerSecWidth);
+    setFixedColumnWidth(8, minComboWidth);
+    for (int logicalIdx : {4, 9, 10, 11})
         setFixedColumnWidth(logicalIdx, minPercentWidth);
 
     m_cLocale.setNumberOptions(QLocale::DefaultNumberOptions);
@@ -158,9 +164,40 @@ MainWindow::MainWindow(DpsLogic &dpsLogic)
         Q_UNUSED(checked)
         emit packetCaptureReset();
         m_dpsLogic.reset();
+        m_encounter.reset();
         dpsLogicUpdate();
     });
 
+    // Snapshots are immutable, switching is just another pointer to draw from
+    connect(historyMenu, &QMenu::aboutToShow,
+            this, [=] {
+        historyMenu->clear();
+
+        auto liveAction = historyMenu->addAction(tr("Current"), this, [=] {
+            m_encounter.reset();
+            dpsLogicUpdate();
+        });
+        liveAction->setCheckable(true);
+        liveAction->setChecked(!m_encounter);
+        historyMenu->addSeparator();
+
+        for (uint32_t i = 0; i < m_dpsLogic.getNumEncounters(); ++i)
+        {
+            const auto encounter = m_dpsLogic.getEncounter(i);
+            const auto text = QString("%1 - %2 - %3K")
+                .arg(encounter->getWorldId())
+                .arg(QTime(0, 0).addSecs(encounter->getTime()).toString("mm:ss"))
+                .arg(m_cLocale.toString(encounter->getTotalDamage() / 1e3, 'f', 0))
+            ;
+            auto action = historyMenu->addAction(text, this, [=] {
+                m_encounter = encounter;
+                dpsLogicUpdate();
+            });
+            action->setCheckable(true);
+            action->setChecked(m_encounter == encounter);
+        }
+    });
+
     connect(menu, &QMenu::aboutToShow,
             this, [=] {
         suspendAction->setVisible(m_dpsLogic.isValid() && (!m_dpsLogic.isSuspended() || m_dpsLogic.isAutoResume()));
@@ -175,6 +212,19 @@ MainWindow::MainWindow(DpsLogic &dpsLogic)
     connect(&dpsLogic, &DpsLogic::update,
             this, &MainWindow::dpsLogicUpdate);
 
+    connect(m_players, &QTableWidget::cellDoubleClicked,
+            this, [this](int row, int column) {
+        Q_UNUSED(column)
+        const auto item = m_players->item(row, 0);
+        const auto playerId = item ? item->data(Qt::UserRole) : QVariant();
+        if (!playerId.isValid())
+            return; // No skills in the history
+
+        auto dialog = new SkillsDialog(m_dpsLogic, playerId.toUInt(), item->text(), this);
+        dialog->setAttribute(Qt::WA_DeleteOnClose);
+        dialog->show();
+    });
+
     connect(horizontalHeader, &QHeaderView::sectionResized,
             this, [this](int logicalIndex, int oldSize, int newSize) {
         Q_UNUSED(logicalIndex)
@@ -201,7 +251,9 @@ void MainWindow::dpsLogicUpdate()
 {
     bool doUpdateTitle = false;
 
-    double time = m_dpsLogic.getTime();
+    const auto encounter = m_encounter.get();
+
+    double time = encounter ? encounter->getTime() : m_dpsLogic.getTime();
     if (!qIsNaN(time))
     {
         const uint32_t timeInt = time;
@@ -221,17 +273,35 @@ void MainWindow::dpsLogicUpdate()
         time = 1.0;
     }
 
-    const uint32_t worldId = m_dpsLogic.getWorldId();
+    const uint32_t worldId = encounter ? encounter->getWorldId() : m_dpsLogic.getWorldId();
     if (m_worldId != worldId)
     {
         m_worldId = worldId;
         doUpdateTitle = true;
     }
 
+    // Of the target hit last, the boss most of the time
+    optional<uint32_t> timeToKill;
+    DpsLogic::TargetStats targetStats;
+    if (!encounter && m_dpsLogic.getLastTarget(targetStats) && !qIsNaN(targetStats.timeToKill))
+        timeToKill = static_cast<uint32_t>(min(targetStats.timeToKill, 3599.0));
+    if (m_timeToKill != timeToKill)
+    {
+        m_timeToKill = timeToKill;
+        doUpdateTitle = true;
+    }
+
+    const bool history = (encounter != nullptr);
+    if (m_history != history)
+    {
+        m_history = history;
+        doUpdateTitle = true;
+    }
+
     if (doUpdateTitle)
         updateTitle();
 
-    const int nRows = m_dpsLogic.getNumPlayers();
+    const int nRows = encounter ? encounter->getNumPlayers() : m_dpsLogic.getNumPlayers();
     if (m_players->rowCount() != nRows)
     {
         m_players->setRowCount(nRows);
@@ -270,7 +340,7 @@ void MainWindow::dpsLogicUpdate()
 
     double firstRowDamage = 0.0;
 
-    m_dpsLogic.iterate([&](uint32_t row, const QString &playerName, uint8_t characterClass, uint64_t totalDamage, const DpsLogic::PlayerStats &playerStats) {
+    const DpsLogic::IterateCallback drawRow = [&](uint32_t row, const QString &playerName, uint8_t characterClass, uint64_t totalDamage, const DpsLogic::PlayerStats &playerStats) {
         const auto teamDamage = static_cast<double>(playerStats.damage) / totalDamage;
 
         if (row == 0)
@@ -306,21 +376,32 @@ void MainWindow::dpsLogicUpdate()
         }
 
         cellItem[0]->setText(playerName);
+        cellItem[0]->setData(Qt::UserRole, encounter ? QVariant() : QVariant(m_dpsLogic.getPlayerId(row))); // The ranking may change before a double click
         cellItem[1]->setText(QString("%1K").arg(m_cLocale.toString(playerStats.damage / time / 1e3, 'f', 0)));
-        cellItem[2]->setText(QString("%1%").arg(teamDamage * 100.0, 0, 'f', 1));
-        cellItem[3]->setText(QString("%1K").arg(m_cLocale.toString(playerStats.damage / 1e3, 'f', 0)));
-        cellItem[4]->setText(QString("%1").arg(m_cLocale.toString(playerStats.damageReceived)));
-        cellItem[5]->setText(QString("%1").arg(m_cLocale.toString(playerStats.hits / time, 'f', 2)));
-        cellItem[6]->setText(QString("%1").arg(playerStats.maxCombo));
-        cellItem[7]->setText(QString("%1%").arg(playerStats.misses * 100.0 / playerStats.hits, 0, 'f', 1));
-        cellItem[8]->setText(QString("%1%").arg(playerStats.crits * 100.0 / playerStats.hits, 0, 'f', 1));
-        cellItem[9]->setText(QString("%1%").arg(playerStats.soulstones * 100.0 / playerStats.hits, 0, 'f', 1));
-    });
+        cellItem[2]->setText(QString("%1K").arg(m_cLocale.toString(playerStats.dps5s / 1e3, 'f', 0)));
+        cellItem[3]->setText(QString("%1K").arg(m_cLocale.toString(playerStats.peakDps / 1e3, 'f', 0)));
+        cellItem[4]->setText(QString("%1%").arg(teamDamage * 100.0, 0, 'f', 1));
+        cellItem[5]->setText(QString("%1K").arg(m_cLocale.toString(playerStats.damage / 1e3, 'f', 0)));
+        cellItem[6]->setText(QString("%1").arg(m_cLocale.toString(playerStats.damageReceived)));
+        cellItem[7]->setText(QString("%1").arg(m_cLocale.toString(playerStats.hits / time, 'f', 2)));
+        cellItem[8]->setText(QString("%1").arg(playerStats.maxCombo));
+        cellItem[9]->setText(QString("%1%").arg(playerStats.misses * 100.0 / playerStats.hits, 0, 'f', 1));
+        cellItem[10]->setText(QString("%1%").arg(playerStats.crits * 100.0 / playerStats.hits, 0, 'f', 1));
+        cellItem[11]->setText(QString("%1%").arg(playerStats.soulstones * 100.0 / playerStats.hits, 0, 'f', 1));
+    };
+    if (encounter)
+        encounter->iterate(drawRow);
+    else
+        m_dpsLogic.iterate(drawRow);
 }
 
 void MainWindow::updateTitle()
 {
     QString title;
+    if (m_history)
+    {
+        title += tr("History - ");
+    }
     if (m_worldId > 0)
     {
         title += QString("%1 - ").arg(m_worldId);
@@ -329,6 +410,10 @@ void MainWindow::updateTitle()
     {
         title += QString("%1 - ").arg(QTime(0, 0).addSecs(m_time.value()).toString("mm:ss"));
     }
+    if (m_timeToKill.has_value())
+    {
+        title += tr("TTK %1 - ").arg(QTime(0, 0).addSecs(m_timeToKill.value()).toString("mm:ss"));
+    }
     title += m_constantTitle;
     m_titleBar->setText(title);
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "DpsLogic.hpp"
+
 #include <QWidget>
 #include <QLocale>
 
@@ -7,7 +9,6 @@
 
 class QTableWidget;
 class TitleBar;
-class DpsLogic;
 
 class MainWindow : public QWidget
 {
@@ -28,11 +29,14 @@ private:
 
 signals:
     void packetCaptureReset();
+    void statisticsRequested();
+    void profileRequested();
 
 private:
     const QString m_constantTitle;
 
     DpsLogic &m_dpsLogic;
+    DpsLogic::EncounterPtr m_encounter; // Shown instead of the current one
 
     TitleBar *const m_titleBar;
     QTableWidget *const m_players;
@@ -40,6 +44,8 @@ private:
     QLocale m_cLocale;
 
     std::optional<uint32_t> m_time;
+    std::optional<uint32_t> m_timeToKill;
+    bool m_history = false;
     uint32_t m_worldId = 0;
 
     std::array<QColor, 9> m_colors;
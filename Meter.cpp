@@ -0,0 +1,297 @@
+#include "Meter.hpp"
+#include "CaptureThread.hpp"
+#include "EventLog.hpp"
+#include "OpCodeProfiler.hpp"
+#include "PacketCapture.hpp"
+#include "PacketRecorder.hpp"
+#include "SWPacketCapture.hpp"
+
+#include <QCommandLineParser>
+#include <QDebug>
+
+using namespace std;
+
+void Meter::addOptions(QCommandLineParser &parser)
+{
+    parser.addOptions({
+        {"replay", "Replay packets from a pcap/pcapng capture file.", "file"},
+        {"speed", "Replay speed factor, 0 plays as fast as possible (default: 1).", "factor", "1"},
+        {"capture", "Live capture backend: pcap, tpacket (Linux TPACKET_V3 ring).", "backend", "pcap"},
+        {"static-filter", "Don't narrow the kernel packet filter to the active game connections."},
+        {"immediate", "Deliver packets as soon as they arrive (lower latency, more wakeups)."},
+        {"buffer-size", "Kernel capture buffer size in KiB, up to 1 GiB (default: backend default).", "KiB", "0"},
+        {"snaplen", "Bytes captured per packet (default: 65535).", "bytes", "65535"},
+        {"nano-timestamps", "Request nanosecond packet timestamps."},
+        {"lazy-decrypt", "Decrypt only the opcode and the fields the meter reads."},
+        {"decoder-threads", "Decode the connections on N threads, for several game clients on this host (default: 1).", "N", "1"},
+        {"record", "Record game traffic to pcapng files in the directory.", "directory"},
+        {"record-max-size", "Start a new recording file after this size in MiB (default: 100).", "MiB", "100"},
+        {"record-per-encounter", "Start a new recording file for every dungeon."},
+        {"record-keep", "Recording files to keep, older ones are deleted, 0 keeps all (default: 10).", "files", "10"},
+        {"event-log", "Write decoded events to a compact event log file.", "file"},
+        {"opcode-profile", "Write per-opcode traffic and unknown opcode samples to the file on exit.", "file"},
+    });
+}
+
+Meter::Meter(QObject *parent)
+    : QObject(parent)
+    , m_eventQueue(1 << 16)
+{
+}
+Meter::~Meter()
+{
+}
+
+bool Meter::create(const QCommandLineParser &parser)
+{
+    m_replay = parser.isSet("replay");
+
+    unique_ptr<PacketCapture> packetCapture;
+    if (m_replay)
+    {
+        bool ok = false;
+        const double speed = parser.value("speed").toDouble(&ok);
+        if (!ok || speed < 0.0)
+        {
+            qCritical() << "Invalid replay speed:" << parser.value("speed");
+            return false;
+        }
+
+        packetCapture = PacketCapture::createReplay(parser.value("replay"), speed);
+        if (!packetCapture)
+            return false;
+    }
+    else
+    {
+        auto backend = PacketCapture::Backend::Default;
+
+        const auto backendName = parser.value("capture");
+        if (backendName == "tpacket")
+        {
+            backend = PacketCapture::Backend::TPacketV3;
+        }
+        else if (backendName != "pcap")
+        {
+            qCritical() << "Unknown capture backend:" << backendName;
+            return false;
+        }
+
+        PacketCapture::Options options;
+        options.immediateMode = parser.isSet("immediate");
+        options.nanoTimestamps = parser.isSet("nano-timestamps");
+
+        bool bufferSizeOk = false, snapLenOk = false;
+        const int bufferSize = parser.value("buffer-size").toInt(&bufferSizeOk);
+        options.snapLen = parser.value("snaplen").toInt(&snapLenOk);
+        if (!bufferSizeOk || bufferSize < 0 || bufferSize > 1024 * 1024)
+        {
+            qCritical() << "Invalid buffer size:" << parser.value("buffer-size");
+            return false;
+        }
+        if (!snapLenOk || options.snapLen <= 0)
+        {
+            qCritical() << "Invalid snapshot length:" << parser.value("snaplen");
+            return false;
+        }
+        options.bufferSize = bufferSize * 1024;
+
+        packetCapture = PacketCapture::create(backend, options);
+        if (parser.isSet("static-filter"))
+            packetCapture->setDynamicFilter(false);
+    }
+
+    if (parser.isSet("record"))
+    {
+        PacketRecorder::Options options;
+        options.directory = parser.value("record");
+
+        bool maxFileSizeOk = false, maxFilesOk = false;
+        options.maxFileSize = parser.value("record-max-size").toLongLong(&maxFileSizeOk) << 20;
+        options.maxFiles = parser.value("record-keep").toInt(&maxFilesOk);
+        if (!maxFileSizeOk || options.maxFileSize <= 0 || !maxFilesOk || options.maxFiles < 0)
+        {
+            qCritical() << "Invalid recording limits";
+            return false;
+        }
+
+        m_packetRecorder = make_unique<PacketRecorder>(options);
+        if (!m_packetRecorder->start())
+            return false;
+
+        packetCapture->setRecorder(m_packetRecorder.get());
+
+        if (parser.isSet("record-per-encounter"))
+        {
+            connect(&m_dpsLogic, &DpsLogic::encounterStarted, this, [this] {
+                m_packetRecorder->rotate();
+            });
+        }
+    }
+
+    if (m_replay)
+    {
+        // Time advances with the capture timestamps only, so replays give the same numbers
+        m_dpsLogic.setRealTime(false);
+    }
+
+    if (parser.isSet("event-log"))
+    {
+        m_eventLog = make_unique<EventLogWriter>();
+        if (!m_eventLog->open(parser.value("event-log")))
+            return false;
+    }
+
+    m_opCodeProfileFileName = parser.value("opcode-profile");
+
+    bool nDecodersOk = false;
+    const uint32_t nDecoders = parser.value("decoder-threads").toUInt(&nDecodersOk);
+    if (!nDecodersOk || nDecoders < 1 || nDecoders > 64)
+    {
+        qCritical() << "Invalid number of decoder threads:" << parser.value("decoder-threads");
+        return false;
+    }
+
+    m_eventQueue.setConsumer([this](const DpsEvent *events, size_t count) {
+        if (m_eventLog)
+            m_eventLog->add(events, count);
+        m_dpsLogic.ingest(events, count);
+    });
+    if (m_replay)
+    {
+        // Replay can wait for the consumer, no need to lose events
+        m_eventQueue.setBlocking(true);
+    }
+
+    m_captureThread = make_unique<CaptureThread>(move(packetCapture), m_eventQueue, nDecoders);
+    m_captureThread->setBlocking(m_replay);
+    for (uint32_t i = 0; i < m_captureThread->getNumDecoders(); ++i)
+        m_captureThread->getDecoder(i)->setLazyDecrypt(parser.isSet("lazy-decrypt"));
+
+    if (m_replay)
+    {
+        connect(
+            m_captureThread->getPacketCapture(), &PacketCapture::finished,
+            this, [this] {
+                const double time = m_replayTimer.nsecsElapsed() / 1e9;
+                const auto nPackets = m_captureThread->getPacketCapture()->getNumPackets();
+                const auto nEvents = m_eventQueue.getNumEvents();
+                qInfo().noquote() << QString("Replay finished: %1 packets, %2 events in %3 s (%4 packets/s, %5 events/s)")
+                    .arg(nPackets)
+                    .arg(nEvents)
+                    .arg(time, 0, 'f', 3)
+                    .arg(nPackets / time, 0, 'f', 0)
+                    .arg(nEvents / time, 0, 'f', 0)
+                ;
+                emit replayFinished();
+            },
+            Qt::QueuedConnection
+        );
+    }
+
+    return true;
+}
+
+bool Meter::start()
+{
+    m_replayTimer.start();
+    if (!m_captureThread->init(s_port))
+    {
+        qWarning() << "Error initializing packet capture";
+        return false;
+    }
+    return true;
+}
+
+void Meter::finish()
+{
+    if (m_eventLog)
+        m_eventLog->finish();
+
+    if (!m_opCodeProfileFileName.isEmpty() && !getOpCodeProfile()->dump(m_opCodeProfileFileName))
+        qWarning() << "Can't write opcode profile:" << m_opCodeProfileFileName;
+}
+
+unique_ptr<OpCodeProfiler> Meter::getOpCodeProfile() const
+{
+    auto profile = make_unique<OpCodeProfiler>();
+    for (uint32_t i = 0; i < m_captureThread->getNumDecoders(); ++i)
+        profile->merge(m_captureThread->getDecoder(i)->getProfiler());
+    return profile;
+}
+
+QStringList Meter::getStatistics() const
+{
+    const auto packetCapture = m_captureThread->getPacketCapture();
+
+    // Kept by the capture thread, which can be waiting for this thread to drain the events
+    const auto nDrops = packetCapture->getNumDrops();
+
+    QStringList lines;
+    const auto nPackets = packetCapture->getNumPackets();
+    const auto nPayloadPackets = m_captureThread->getNumPayloadPackets();
+    lines += QString("Packets: %1, with payload: %2, discarded in user space: %3, kernel drops: %4")
+        .arg(nPackets)
+        .arg(nPayloadPackets)
+        .arg(nPackets - nPayloadPackets)
+        .arg(nDrops)
+    ;
+    lines += QString("Kernel filter updates: %1").arg(packetCapture->getNumFilterUpdates());
+    uint64_t nBytes = 0, nCopiedBytes = 0, nPayloadBytes = 0, nDecryptedBytes = 0;
+    for (uint32_t i = 0; i < m_captureThread->getNumDecoders(); ++i)
+    {
+        const auto decoder = m_captureThread->getDecoder(i);
+        nBytes += decoder->getNumBytes();
+        nCopiedBytes += decoder->getNumCopiedBytes();
+        nPayloadBytes += decoder->getNumPayloadBytes();
+        nDecryptedBytes += decoder->getNumDecryptedBytes();
+    }
+    if (m_captureThread->getNumDecoders() > 1)
+    {
+        lines += QString("Decoder threads: %1, packets dropped by busy decoders: %2")
+            .arg(m_captureThread->getNumDecoders())
+            .arg(m_captureThread->getNumDecoderDrops())
+        ;
+    }
+    lines += QString("Decoder: %1 bytes, %2 bytes copied (%3%)")
+        .arg(nBytes)
+        .arg(nCopiedBytes)
+        .arg(nCopiedBytes * 100.0 / qMax<uint64_t>(nBytes, 1), 0, 'f', 1)
+    ;
+    lines += QString("Decryption: %1 of %2 payload bytes (%3%)")
+        .arg(nDecryptedBytes)
+        .arg(nPayloadBytes)
+        .arg(nDecryptedBytes * 100.0 / qMax<uint64_t>(nPayloadBytes, 1), 0, 'f', 1)
+    ;
+    lines += QString("Event queue: %1 / %2 (max %3), events: %4, overflows: %5")
+        .arg(m_eventQueue.getOccupancy())
+        .arg(m_eventQueue.getCapacity())
+        .arg(m_eventQueue.getMaxOccupancy())
+        .arg(m_eventQueue.getNumEvents())
+        .arg(m_eventQueue.getNumOverflows())
+    ;
+    if (m_packetRecorder)
+    {
+        lines += QString("Recording: %1 packets, %2 dropped, %3 MiB written, %4 files")
+            .arg(m_packetRecorder->getNumPackets())
+            .arg(m_packetRecorder->getNumDrops())
+            .arg(m_packetRecorder->getNumBytesWritten() / 1048576.0, 0, 'f', 1)
+            .arg(m_packetRecorder->getNumFiles())
+        ;
+    }
+    if (m_eventLog)
+    {
+        lines += QString("Event log: %1 events, %2 MiB written")
+            .arg(m_eventLog->getNumEvents())
+            .arg(m_eventLog->getNumBytesWritten() / 1048576.0, 0, 'f', 1)
+        ;
+    }
+    const auto &latency = m_dpsLogic.getLatency();
+    lines += QString("Latency (capture -> update): mean %1 ms, p50 %2 ms, p99 %3 ms, max %4 ms, samples: %5")
+        .arg(latency.getMean() / 1e6, 0, 'f', 2)
+        .arg(latency.getPercentile(0.50) / 1e6, 0, 'f', 2)
+        .arg(latency.getPercentile(0.99) / 1e6, 0, 'f', 2)
+        .arg(latency.getMax() / 1e6, 0, 'f', 2)
+        .arg(latency.getNumSamples())
+    ;
+    return lines;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "DpsLogic.hpp"
+#include "EventQueue.hpp"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QStringList>
+
+#include <memory>
+
+class QCommandLineParser;
+class CaptureThread;
+class PacketRecorder;
+class EventLogWriter;
+class OpCodeProfiler;
+
+// Command line options and the capture pipeline shared by the GUI and the headless meter:
+// PacketCapture -> SWPacketCapture (capture thread) -> EventQueue -> DpsLogic
+class Meter : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr uint16_t s_port = 15011;
+
+    static void addOptions(QCommandLineParser &parser);
+
+public:
+    Meter(QObject *parent = nullptr);
+    ~Meter();
+
+    // Errors are reported, nothing is captured before "start()"
+    bool create(const QCommandLineParser &parser);
+    bool start();
+
+    // Writes the files which are complete only at the end of the session
+    void finish();
+
+    inline bool isReplay() const;
+
+    inline DpsLogic &getDpsLogic();
+    inline CaptureThread &getCaptureThread() const;
+
+    QStringList getStatistics() const;
+
+    // Snapshot of the counters of all decoders
+    std::unique_ptr<OpCodeProfiler> getOpCodeProfile() const;
+
+signals:
+    void replayFinished();
+
+private:
+    bool m_replay = false;
+    QString m_opCodeProfileFileName;
+    QElapsedTimer m_replayTimer;
+
+    // Destroyed in reverse order, the capture thread first
+    DpsLogic m_dpsLogic;
+    std::unique_ptr<PacketRecorder> m_packetRecorder;
+    std::unique_ptr<EventLogWriter> m_eventLog;
+    EventQueue m_eventQueue;
+    std::unique_ptr<CaptureThread> m_captureThread;
+};
+
+inline bool Meter::isReplay() const
+{
+    return m_replay;
+}
+
+inline DpsLogic &Meter::getDpsLogic()
+{
+    return m_dpsLogic;
+}
+inline CaptureThread &Meter::getCaptureThread() const
+{
+    return *m_captureThread;
+}
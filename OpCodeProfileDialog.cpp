@@ -0,0 +1,71 @@
+#include "OpCodeProfileDialog.hpp"
+#include "OpCodeProfiler.hpp"
+#include "Meter.hpp"
+
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include <QTextStream>
+#include <QTimer>
+#include <QVBoxLayout>
+
+void OpCodeProfileDialog::open(const Meter &meter, QWidget *parent)
+{
+    if (const auto dialog = parent->findChild<OpCodeProfileDialog *>(QString(), Qt::FindDirectChildrenOnly))
+    {
+        dialog->raise();
+        dialog->activateWindow();
+        return;
+    }
+
+    auto dialog = new OpCodeProfileDialog(meter, parent);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->show();
+}
+
+OpCodeProfileDialog::OpCodeProfileDialog(const Meter &meter, QWidget *parent)
+    : QDialog(parent)
+    , m_meter(meter)
+    , m_text(new QPlainTextEdit)
+{
+    setWindowTitle(tr("Protocol profile"));
+    resize(800, 400);
+
+    m_text->setReadOnly(true);
+    m_text->setLineWrapMode(QPlainTextEdit::NoWrap);
+
+    auto saveButton = new QPushButton(tr("Save..."));
+    connect(saveButton, &QPushButton::clicked,
+            this, &OpCodeProfileDialog::save);
+
+    auto layout = new QVBoxLayout(this);
+    layout->addWidget(m_text);
+    layout->addWidget(saveButton);
+
+    auto timer = new QTimer(this);
+    connect(timer, &QTimer::timeout,
+            this, &OpCodeProfileDialog::refresh);
+    timer->start(1000);
+
+    refresh();
+}
+OpCodeProfileDialog::~OpCodeProfileDialog()
+{
+}
+
+void OpCodeProfileDialog::refresh()
+{
+    QString report;
+    QTextStream stream(&report);
+    m_meter.getOpCodeProfile()->write(stream, false);
+    stream.flush();
+    m_text->setPlainText(report);
+}
+
+void OpCodeProfileDialog::save()
+{
+    const auto fileName = QFileDialog::getSaveFileName(this, tr("Save protocol profile"), QString(), "Text files (*.txt)");
+    if (!fileName.isEmpty() && !m_meter.getOpCodeProfile()->dump(fileName))
+        QMessageBox::warning(this, QString(), tr("Can't write %1").arg(fileName));
+}
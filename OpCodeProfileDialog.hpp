@@ -0,0 +1,29 @@
+#pragma once
+
+#include <QDialog>
+
+class QPlainTextEdit;
+class Meter;
+
+// Opcode counters of all decoders, refreshed every second, the full profile with samples can be saved
+class OpCodeProfileDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    // Raises the dialog when it's already open
+    static void open(const Meter &meter, QWidget *parent);
+
+public:
+    OpCodeProfileDialog(const Meter &meter, QWidget *parent = nullptr);
+    ~OpCodeProfileDialog();
+
+private:
+    void refresh();
+    void save();
+
+private:
+    const Meter &m_meter;
+
+    QPlainTextEdit *const m_text;
+};
@@ -0,0 +1,179 @@
+#include "OpCodeProfiler.hpp"
+
+#include <QSaveFile>
+#include <QStringList>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+OpCodeProfiler::OpCodeProfiler()
+    : m_entries(make_unique<Entry[]>(s_maxOpCodes))
+    , m_samples(make_unique<SampleData[]>(s_maxSamples))
+{
+}
+OpCodeProfiler::~OpCodeProfiler()
+{
+}
+
+void OpCodeProfiler::addSample(uint16_t opCode, int64_t timestamp, const uint8_t *data, uint32_t size)
+{
+    const auto entry = find(opCode, false);
+    const auto nSamples = m_nSamples.load(memory_order_relaxed);
+    if (!entry || nSamples >= s_maxSamples)
+        return;
+
+    auto &sample = m_samples[nSamples];
+    sample.opCode = opCode;
+    sample.timestamp = timestamp;
+    sample.size = size;
+    memcpy(sample.data, data, min(size, s_maxSampleSize));
+
+    entry->nSamples += 1;
+    m_nSamples.store(nSamples + 1, memory_order_release);
+}
+
+void OpCodeProfiler::merge(const OpCodeProfiler &other)
+{
+    for (auto &&stats : other.getStats())
+    {
+        const auto entry = find(stats.opCode, true);
+        if (!entry)
+        {
+            increment(m_nUntrackedFrames, stats.nFrames);
+            continue;
+        }
+
+        if (entry->key.load(memory_order_relaxed) == 0)
+        {
+            entry->known.store(stats.known, memory_order_relaxed);
+            entry->key.store(stats.opCode + 1u, memory_order_release);
+        }
+
+        increment(entry->nFrames, stats.nFrames);
+        increment(entry->nBytes, stats.nBytes);
+        for (uint32_t b = 0; b < s_nSizeBuckets; ++b)
+            increment(entry->sizeHistogram[b], stats.sizeHistogram[b]);
+    }
+    increment(m_nUntrackedFrames, other.getNumUntrackedFrames());
+
+    for (auto &&sample : other.getSamples())
+    {
+        const auto entry = find(sample.opCode, false);
+        if (entry && entry->nSamples < s_maxSamplesPerOpCode)
+            addSample(sample.opCode, sample.timestamp, reinterpret_cast<const uint8_t *>(sample.data.constData()), sample.size);
+    }
+}
+
+vector<OpCodeProfiler::Stats> OpCodeProfiler::getStats() const
+{
+    vector<Stats> stats;
+    for (uint32_t i = 0; i < s_maxOpCodes; ++i)
+    {
+        const auto &entry = m_entries[i];
+        const auto key = entry.key.load(memory_order_acquire);
+        if (key == 0)
+            continue;
+
+        auto &s = stats.emplace_back();
+        s.opCode = key - 1;
+        s.known = entry.known.load(memory_order_relaxed);
+        s.nFrames = entry.nFrames.load(memory_order_relaxed);
+        s.nBytes = entry.nBytes.load(memory_order_relaxed);
+        for (uint32_t b = 0; b < s_nSizeBuckets; ++b)
+            s.sizeHistogram[b] = entry.sizeHistogram[b].load(memory_order_relaxed);
+    }
+    sort(stats.begin(), stats.end(), [](const Stats &a, const Stats &b) {
+        return a.nBytes > b.nBytes;
+    });
+    return stats;
+}
+
+vector<OpCodeProfiler::Sample> OpCodeProfiler::getSamples() const
+{
+    const auto nSamples = m_nSamples.load(memory_order_acquire);
+
+    vector<Sample> samples(nSamples);
+    for (uint32_t i = 0; i < nSamples; ++i)
+    {
+        const auto &sampleData = m_samples[i];
+        auto &sample = samples[i];
+        sample.opCode = sampleData.opCode;
+        sample.timestamp = sampleData.timestamp;
+        sample.size = sampleData.size;
+        sample.data = QByteArray(reinterpret_cast<const char *>(sampleData.data), min(sampleData.size, s_maxSampleSize));
+    }
+    return samples;
+}
+
+void OpCodeProfiler::write(QTextStream &stream, bool withSamples) const
+{
+    const auto stats = getStats();
+
+    uint64_t nTotalBytes = 0;
+    for (auto &&s : stats)
+        nTotalBytes += s.nBytes;
+
+    auto opCodeString = [](uint16_t opCode) {
+        return QString("0x%1").arg(opCode, 4, 16, QLatin1Char('0'));
+    };
+
+    stream << QString("%1 %2 %3 %4 %5  %6\n")
+        .arg("opcode", -8)
+        .arg("known", -6)
+        .arg("frames", 12)
+        .arg("bytes", 14)
+        .arg("share", 7)
+        .arg("payload sizes (upper bound: frames)")
+    ;
+    for (auto &&s : stats)
+    {
+        QStringList sizes;
+        for (uint32_t b = 0; b < s_nSizeBuckets; ++b)
+        {
+            if (s.sizeHistogram[b] > 0)
+                sizes += QString("%1:%2").arg((1u << b) - 1).arg(s.sizeHistogram[b]);
+        }
+
+        stream << QString("%1 %2 %3 %4 %5%  %6\n")
+            .arg(opCodeString(s.opCode), -8)
+            .arg(s.known ? "yes" : "no", -6)
+            .arg(s.nFrames, 12)
+            .arg(s.nBytes, 14)
+            .arg(s.nBytes * 100.0 / max<uint64_t>(nTotalBytes, 1), 6, 'f', 1)
+            .arg(sizes.join(' '))
+        ;
+    }
+    if (getNumUntrackedFrames() > 0)
+        stream << "Untracked frames: " << getNumUntrackedFrames() << '\n';
+
+    if (!withSamples)
+        return;
+
+    for (auto &&sample : getSamples())
+    {
+        stream << QString("\n%1 at %2 ns, %3 bytes%4\n")
+            .arg(opCodeString(sample.opCode))
+            .arg(sample.timestamp)
+            .arg(sample.size)
+            .arg((sample.size > s_maxSampleSize) ? " (truncated)" : "")
+        ;
+        for (qsizetype offset = 0; offset < sample.data.size(); offset += 16)
+            stream << QString("%1  ").arg(offset, 4, 16, QLatin1Char('0')) << sample.data.mid(offset, 16).toHex(' ') << '\n';
+    }
+}
+
+bool OpCodeProfiler::dump(const QString &fileName) const
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    QTextStream stream(&file);
+    write(stream, true);
+    stream.flush();
+
+    return file.commit();
+}
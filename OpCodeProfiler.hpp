@@ -0,0 +1,154 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class QTextStream;
+
+// Per-opcode traffic counters and samples of unknown opcodes.
+// Written by the capture thread only, readable from any thread without locking.
+class OpCodeProfiler
+{
+public:
+    static constexpr uint32_t s_maxOpCodes = 1024; // Further opcodes are counted as untracked
+    static constexpr uint32_t s_nSizeBuckets = 17; // Power of two payload sizes, up to 64 KiB
+
+    static constexpr uint32_t s_maxSamples = 256;
+    static constexpr uint32_t s_maxSamplesPerOpCode = 4;
+    static constexpr uint32_t s_maxSampleSize = 1024; // Longer payloads are truncated
+
+    struct Stats
+    {
+        uint16_t opCode = 0;
+        bool known = false;
+        uint64_t nFrames = 0;
+        uint64_t nBytes = 0;
+        std::array<uint64_t, s_nSizeBuckets> sizeHistogram = {};
+    };
+
+    struct Sample
+    {
+        uint16_t opCode = 0;
+        int64_t timestamp = 0; // Nanoseconds since epoch
+        uint32_t size = 0; // Of the whole payload
+        QByteArray data; // Decrypted, without the opcode
+    };
+
+public:
+    OpCodeProfiler();
+    ~OpCodeProfiler();
+
+    // Capture thread only, returns true when a sample of this unknown opcode is wanted
+    inline bool add(uint16_t opCode, uint32_t size, bool known);
+    void addSample(uint16_t opCode, int64_t timestamp, const uint8_t *data, uint32_t size);
+
+    // Writer of this profiler, adds the counters and samples of another one, for several decoders
+    void merge(const OpCodeProfiler &other);
+
+    // Any thread, sorted by bytes
+    std::vector<Stats> getStats() const;
+    std::vector<Sample> getSamples() const;
+    inline uint64_t getNumUntrackedFrames() const;
+
+    void write(QTextStream &stream, bool withSamples) const;
+    bool dump(const QString &fileName) const;
+
+private:
+    struct Entry
+    {
+        std::atomic<uint32_t> key {0}; // Opcode + 1, 0 when empty
+        std::atomic<bool> known {false};
+        std::atomic<uint64_t> nFrames {0};
+        std::atomic<uint64_t> nBytes {0};
+        std::array<std::atomic<uint64_t>, s_nSizeBuckets> sizeHistogram = {};
+        uint32_t nSamples = 0; // Capture thread only
+    };
+
+    struct SampleData
+    {
+        uint16_t opCode;
+        int64_t timestamp;
+        uint32_t size;
+        uint8_t data[s_maxSampleSize];
+    };
+
+private:
+    static inline uint32_t getSizeBucket(uint32_t size);
+
+    // Single writer, so a relaxed load and store is enough
+    static inline void increment(std::atomic<uint64_t> &counter, uint64_t value);
+
+    inline Entry *find(uint16_t opCode, bool insert);
+
+private:
+    std::unique_ptr<Entry[]> m_entries;
+    std::unique_ptr<SampleData[]> m_samples;
+    std::atomic<uint32_t> m_nSamples {0}; // Published samples
+    std::atomic<uint64_t> m_nUntrackedFrames {0};
+};
+
+inline bool OpCodeProfiler::add(uint16_t opCode, uint32_t size, bool known)
+{
+    const auto entry = find(opCode, true);
+    if (!entry)
+    {
+        increment(m_nUntrackedFrames, 1);
+        return false;
+    }
+
+    if (entry->key.load(std::memory_order_relaxed) == 0)
+    {
+        entry->known.store(known, std::memory_order_relaxed);
+        entry->key.store(opCode + 1u, std::memory_order_release);
+    }
+
+    increment(entry->nFrames, 1);
+    increment(entry->nBytes, size);
+    increment(entry->sizeHistogram[getSizeBucket(size)], 1);
+
+    return (!known && entry->nSamples < s_maxSamplesPerOpCode && m_nSamples.load(std::memory_order_relaxed) < s_maxSamples);
+}
+
+inline uint64_t OpCodeProfiler::getNumUntrackedFrames() const
+{
+    return m_nUntrackedFrames.load(std::memory_order_relaxed);
+}
+
+inline uint32_t OpCodeProfiler::getSizeBucket(uint32_t size)
+{
+    uint32_t bucket = 0;
+    while (size > 0 && bucket < s_nSizeBuckets - 1)
+    {
+        size >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+inline void OpCodeProfiler::increment(std::atomic<uint64_t> &counter, uint64_t value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// Returns a free entry for a new opcode when inserting, its key is set by the caller
+inline OpCodeProfiler::Entry *OpCodeProfiler::find(uint16_t opCode, bool insert)
+{
+    const uint32_t key = opCode + 1u;
+    uint32_t idx = (opCode * 0x9E3779B1u) >> 22;
+    for (uint32_t i = 0; i < s_maxOpCodes; ++i)
+    {
+        auto &entry = m_entries[(idx + i) % s_maxOpCodes];
+        const auto entryKey = entry.key.load(std::memory_order_relaxed);
+        if (entryKey == key)
+            return &entry;
+        if (entryKey == 0)
+            return insert ? &entry : nullptr;
+    }
+    return nullptr;
+}
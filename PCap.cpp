@@ -21,8 +21,9 @@ static_assert(sizeof(LinuxCookedCapture) == 16);
 
 /**/
 
-PCap::PCap()
-    : m_socketNotifier(QSocketNotifier::Read)
+PCap::PCap(const Options &options)
+    : m_options(options)
+    , m_socketNotifier(QSocketNotifier::Read, this)
 {
     connect(&m_socketNotifier, &QSocketNotifier::activated,
             this, &PCap::activated);
@@ -37,28 +38,41 @@ bool PCap::init(uint16_t port)
     closeHandle();
 
     char errbuf[PCAP_ERRBUF_SIZE] = {};
-    m_handle = pcap_open_live(nullptr, 65535, false, 100, errbuf);
+    m_handle = pcap_create(nullptr, errbuf);
     if (!m_handle)
     {
         qCritical() << errbuf;
         return false;
     }
 
-    const auto filterStr = QString("tcp port %1").arg(port).toLatin1();
-
-    bpf_program fp = {};
-    if (pcap_compile(m_handle, &fp, filterStr, true, PCAP_NETMASK_UNKNOWN) == -1)
+    pcap_set_snaplen(m_handle, m_options.snapLen);
+    pcap_set_promisc(m_handle, false);
+    pcap_set_timeout(m_handle, 100);
+    pcap_set_immediate_mode(m_handle, m_options.immediateMode);
+    if (m_options.bufferSize > 0)
+        pcap_set_buffer_size(m_handle, m_options.bufferSize);
+    if (m_options.nanoTimestamps && pcap_set_tstamp_precision(m_handle, PCAP_TSTAMP_PRECISION_NANO) != 0)
+        qWarning() << "Nanosecond timestamps not supported, using microseconds";
+
+    const int status = pcap_activate(m_handle);
+    if (status < 0)
     {
-        qCritical() << pcap_geterr(m_handle);
+        qCritical() << pcap_statustostr(status) << pcap_geterr(m_handle);
+        closeHandle();
         return false;
     }
-
-    if (pcap_setfilter(m_handle, &fp) == -1)
+    if (status > 0)
     {
-        qCritical() << pcap_geterr(m_handle);
-        return false;
+        qWarning() << pcap_statustostr(status) << pcap_geterr(m_handle);
     }
 
+    m_linkType = pcap_datalink(m_handle);
+    m_tstampPrecision = pcap_get_tstamp_precision(m_handle);
+
+    m_port = port;
+    if (!setFilter(makeFilter()))
+        return false;
+
     if (pcap_setnonblock(m_handle, true, errbuf) == -1)
     {
         qCritical() << pcap_geterr(m_handle);
@@ -75,6 +89,40 @@ bool PCap::init(uint16_t port)
     return true;
 }
 
+uint64_t PCap::readNumDrops()
+{
+    if (!m_handle)
+        return 0;
+
+    pcap_stat stats = {};
+    if (pcap_stats(m_handle, &stats) == -1)
+        return 0;
+    return stats.ps_drop;
+}
+
+bool PCap::setFilter(const QByteArray &filterStr)
+{
+    bpf_program fp = {};
+    if (pcap_compile(m_handle, &fp, filterStr, true, PCAP_NETMASK_UNKNOWN) == -1)
+    {
+        qCritical() << pcap_geterr(m_handle);
+        return false;
+    }
+
+    const bool ok = (pcap_setfilter(m_handle, &fp) != -1);
+    if (!ok)
+        qCritical() << pcap_geterr(m_handle);
+
+    pcap_freecode(&fp);
+    return ok;
+}
+
+void PCap::updateFilter()
+{
+    if (m_handle)
+        setFilter(makeFilter());
+}
+
 void PCap::closeHandle()
 {
     if (!m_handle)
@@ -102,32 +150,66 @@ void PCap::activated()
             continue;
         }
 
-        processPacket(packet, header.len);
+        processPacket(packet, header.len, getTimestamp(header.ts));
     }
+
+    flushFlowChanges();
 }
 
-void PCap::processPacket(const uint8_t *packet, qsizetype len)
+void PCap::processPacket(const uint8_t *packet, qsizetype len, int64_t timestamp)
 {
-    if (len < sizeof(LinuxCookedCapture))
-    {
-        qCritical() << "Packet too short";
-        return;
-    }
-    const auto linuxCookedCapture = reinterpret_cast<const LinuxCookedCapture *>(packet);
-    if (ntohs(linuxCookedCapture->packet_type) != 0) // 0 = Unicast to us
-    {
-        return;
-    }
-    if (ntohs(linuxCookedCapture->address_length) != sizeof(LinuxCookedCapture::source_address))
-    {
-        return;
-    }
-    if (ntohs(linuxCookedCapture->protocol) != ETHERTYPE_IP)
+    switch (m_linkType)
     {
-        return;
+        case DLT_LINUX_SLL:
+        {
+            if (len < sizeof(LinuxCookedCapture))
+            {
+                qCritical() << "Packet too short";
+                return;
+            }
+            const auto linuxCookedCapture = reinterpret_cast<const LinuxCookedCapture *>(packet);
+            if (ntohs(linuxCookedCapture->packet_type) != 0) // 0 = Unicast to us
+            {
+                return;
+            }
+            if (ntohs(linuxCookedCapture->address_length) != sizeof(LinuxCookedCapture::source_address))
+            {
+                return;
+            }
+            if (ntohs(linuxCookedCapture->protocol) != ETHERTYPE_IP)
+            {
+                return;
+            }
+            packet += sizeof(LinuxCookedCapture);
+            len -= sizeof(LinuxCookedCapture);
+            break;
+        }
+        case DLT_EN10MB:
+        {
+            if (len < sizeof(ether_header))
+            {
+                qCritical() << "Packet too short";
+                return;
+            }
+            const auto etherHeader = reinterpret_cast<const ether_header *>(packet);
+            if (ntohs(etherHeader->ether_type) != ETHERTYPE_IP)
+            {
+                return;
+            }
+            packet += sizeof(ether_header);
+            len -= sizeof(ether_header);
+            break;
+        }
+        case DLT_RAW:
+        {
+            break;
+        }
+        default:
+        {
+            qCritical() << "Unsupported link type:" << m_linkType;
+            return;
+        }
     }
-    packet += sizeof(LinuxCookedCapture);
-    len -= sizeof(LinuxCookedCapture);
 
-    PacketCapture::processPacket(packet, len);
+    PacketCapture::processPacket(packet, len, timestamp);
 }
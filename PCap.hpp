@@ -11,22 +11,39 @@ class PCap : public PacketCapture
     Q_OBJECT
 
 public:
-    PCap();
+    PCap(const Options &options = {});
     ~PCap();
 
     bool init(uint16_t port) override;
 
-private:
-    void closeHandle();
+protected:
+    uint64_t readNumDrops() override;
 
-    void activated();
+    bool setFilter(const QByteArray &filterStr);
+
+    inline int64_t getTimestamp(const timeval &ts) const;
+
+    void closeHandle();
 
-    void processPacket(const uint8_t *packet, qsizetype len) override;
+    void processPacket(const uint8_t *packet, qsizetype len, int64_t timestamp) override;
 
-signals:
-    void newPacket(const uint8_t *data, int32_t len); // Must be direct connection
+    void updateFilter() override;
 
 private:
+    void activated();
+
+protected:
     pcap_t *m_handle = nullptr;
+    int m_linkType = DLT_LINUX_SLL;
+    int m_tstampPrecision = PCAP_TSTAMP_PRECISION_MICRO;
+
+private:
+    const Options m_options;
     QSocketNotifier m_socketNotifier;
 };
+
+inline int64_t PCap::getTimestamp(const timeval &ts) const
+{
+    const int64_t subsec = (m_tstampPrecision == PCAP_TSTAMP_PRECISION_NANO) ? ts.tv_usec : ts.tv_usec * 1'000ll;
+    return ts.tv_sec * 1'000'000'000ll + subsec;
+}
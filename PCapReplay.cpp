@@ -0,0 +1,121 @@
+#include "PCapReplay.hpp"
+
+#include <QDebug>
+
+using namespace std;
+
+constexpr int g_maxPacketsPerIteration = 1024;
+
+PCapReplay::PCapReplay(const QString &fileName, double speed)
+    : m_fileName(fileName)
+    , m_speed(speed)
+    , m_timer(this)
+{
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout,
+            this, &PCapReplay::play);
+}
+PCapReplay::~PCapReplay()
+{
+}
+
+bool PCapReplay::init(uint16_t port)
+{
+    m_timer.stop();
+    closeHandle();
+
+    char errbuf[PCAP_ERRBUF_SIZE] = {};
+    m_handle = pcap_open_offline_with_tstamp_precision(
+        m_fileName.toLocal8Bit().constData(),
+        PCAP_TSTAMP_PRECISION_NANO,
+        errbuf
+    );
+    if (!m_handle)
+    {
+        qCritical() << errbuf;
+        return false;
+    }
+
+    m_linkType = pcap_datalink(m_handle);
+    m_tstampPrecision = pcap_get_tstamp_precision(m_handle);
+
+    // Only server -> client traffic, there is no packet direction in all link types
+    m_port = port;
+    if (!setFilter(QString("tcp src port %1").arg(port).toLatin1()))
+        return false;
+
+    m_header = nullptr;
+    m_packet = nullptr;
+    m_firstTimestamp = -1;
+
+    m_elapsedTimer.start();
+    m_timer.start(0);
+
+    return true;
+}
+
+void PCapReplay::updateFilter()
+{
+    // Capture files are read once, the static filter above is enough
+}
+
+bool PCapReplay::readNext()
+{
+    for (;;)
+    {
+        const int ret = pcap_next_ex(m_handle, &m_header, &m_packet);
+        if (ret == 1)
+        {
+            if (m_header->caplen < 1 || m_header->len < 1)
+                continue;
+
+            if (m_header->caplen < m_header->len)
+            {
+                qCritical() << "Packet truncated in capture file";
+                continue;
+            }
+
+            return true;
+        }
+
+        if (ret == -1)
+            qCritical() << pcap_geterr(m_handle);
+
+        m_header = nullptr;
+        m_packet = nullptr;
+        return false;
+    }
+}
+
+void PCapReplay::play()
+{
+    for (int i = 0; i < g_maxPacketsPerIteration; ++i)
+    {
+        if (!m_packet && !readNext())
+        {
+            closeHandle();
+            emit finished();
+            return;
+        }
+
+        const int64_t timestamp = getTimestamp(m_header->ts);
+        if (m_firstTimestamp < 0)
+            m_firstTimestamp = timestamp;
+
+        if (m_speed > 0.0)
+        {
+            const int64_t dueTime = (timestamp - m_firstTimestamp) / m_speed;
+            const int64_t waitTime = dueTime - m_elapsedTimer.nsecsElapsed();
+            if (waitTime > 0)
+            {
+                m_timer.start((waitTime + 999'999) / 1'000'000);
+                return;
+            }
+        }
+
+        processPacket(m_packet, m_header->len, timestamp);
+        m_packet = nullptr;
+    }
+
+    m_timer.start(0);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "PCap.hpp"
+
+#include <QElapsedTimer>
+#include <QTimer>
+
+class PCapReplay : public PCap
+{
+    Q_OBJECT
+
+public:
+    PCapReplay(const QString &fileName, double speed);
+    ~PCapReplay();
+
+    bool init(uint16_t port) override;
+
+protected:
+    void updateFilter() override;
+
+private:
+    bool readNext();
+
+    void play();
+
+private:
+    const QString m_fileName;
+    const double m_speed; // 0 = as fast as possible
+
+    QTimer m_timer;
+    QElapsedTimer m_elapsedTimer;
+
+    pcap_pkthdr *m_header = nullptr;
+    const uint8_t *m_packet = nullptr;
+    int64_t m_firstTimestamp = -1;
+};
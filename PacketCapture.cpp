@@ -1,9 +1,14 @@
 #include "PacketCapture.hpp"
+#include "PacketRecorder.hpp"
 
 #ifdef Q_OS_WIN
 #   include "WinDivert.hpp"
 #else
 #   include "PCap.hpp"
+#   include "PCapReplay.hpp"
+#endif
+#ifdef Q_OS_LINUX
+#   include "TPacketV3.hpp"
 #endif
 
 #include <QDebug>
@@ -60,35 +65,174 @@ static_assert(sizeof(tcphdr) == 20);
 
 using namespace std;
 
-unique_ptr<PacketCapture> PacketCapture::create()
+unique_ptr<PacketCapture> PacketCapture::create(Backend backend)
+{
+    return create(backend, Options());
+}
+unique_ptr<PacketCapture> PacketCapture::create(Backend backend, const Options &options)
 {
 #ifdef Q_OS_WIN
+    Q_UNUSED(options)
+    if (backend != Backend::Default)
+        qWarning() << "Capture backend selection is not supported on this platform";
     return make_unique<WinDivert>();
 #else
-    return make_unique<PCap>();
+    switch (backend)
+    {
+        case Backend::TPacketV3:
+#   ifdef Q_OS_LINUX
+            return make_unique<TPacketV3>(options);
+#   else
+            qWarning() << "TPACKET_V3 is available on Linux only, using pcap";
+            return make_unique<PCap>(options);
+#   endif
+        case Backend::Default:
+        case Backend::PCap:
+            break;
+    }
+    return make_unique<PCap>(options);
 #endif
 }
+unique_ptr<PacketCapture> PacketCapture::createReplay(const QString &fileName, double speed)
+{
+#ifdef Q_OS_WIN
+    Q_UNUSED(fileName)
+    Q_UNUSED(speed)
+    qCritical() << "Capture file replay is not supported on this platform";
+    return nullptr;
+#else
+    return make_unique<PCapReplay>(fileName, speed);
+#endif
+}
+
+constexpr int64_t g_flowIdleTimeout = 120'000; // ms
+constexpr int64_t g_flowIdleCheckInterval = 1'000; // ms
+constexpr int64_t g_dropsUpdateInterval = 1'000; // ms
 
 PacketCapture::PacketCapture()
 {
+    m_flows.setRemoveCallback([this](uint32_t flowId) {
+        m_flowsChanged = true;
+        emit flowReset(flowId);
+    });
 }
 PacketCapture::~PacketCapture()
 {
 }
 
+void PacketCapture::updateNumDrops()
+{
+    m_nDrops.store(readNumDrops(), memory_order_relaxed);
+    m_dropsTimer.start();
+}
+
+uint64_t PacketCapture::readNumDrops()
+{
+    return 0;
+}
+
 void PacketCapture::reset()
 {
-    m_hasConnection = false;
-    m_reassembly.clear();
+    m_flows.clear();
+    flushFlowChanges();
 }
 
-void PacketCapture::processPacket(const uint8_t *packet, qsizetype len)
+void PacketCapture::setDynamicFilter(bool dynamicFilter)
+{
+    m_dynamicFilter = dynamicFilter;
+}
+
+void PacketCapture::setRecorder(PacketRecorder *recorder)
+{
+    m_recorder = recorder;
+}
+
+void PacketCapture::setPacketForwarder(const PacketForwarder &packetForwarder)
+{
+    m_packetForwarder = packetForwarder;
+}
+
+void PacketCapture::flushFlowChanges()
+{
+    if (!m_dropsTimer.isValid() || m_dropsTimer.elapsed() >= g_dropsUpdateInterval)
+        updateNumDrops();
+
+    if (!m_flowsChanged)
+        return;
+
+    m_flowsChanged = false;
+
+    if (m_dynamicFilter)
+    {
+        updateFilter();
+        m_nFilterUpdates.fetch_add(1, memory_order_relaxed);
+    }
+}
+void PacketCapture::updateFilter()
+{
+}
+
+QByteArray PacketCapture::makeFilter() const
+{
+    const QByteArray wideFilter = QString("tcp port %1").arg(m_port).toLatin1();
+    if (!m_dynamicFilter)
+        return wideFilter;
+
+    auto ipToString = [](uint32_t ip) {
+        return QString("%1.%2.%3.%4")
+            .arg(ip >> 24)
+            .arg((ip >> 16) & 0xff)
+            .arg((ip >> 8) & 0xff)
+            .arg(ip & 0xff)
+        ;
+    };
+
+    QStringList flows;
+    m_flows.forEach([&](const FlowTable::Flow &flow) {
+        if (flow.key.srcPort != m_port)
+            return; // Client -> server, seen on the wide filter only
+        flows += QString("(src host %1 and dst host %2 and src port %3 and dst port %4)")
+            .arg(ipToString(flow.key.srcIp))
+            .arg(ipToString(flow.key.dstIp))
+            .arg(flow.key.srcPort)
+            .arg(flow.key.dstPort)
+        ;
+    });
+    if (flows.isEmpty())
+        return wideFilter;
+
+    const QString payloadOffset = "((tcp[12] & 0xf0) >> 2)";
+    const QString payloadSize = QString("(ip[2:2] - ((ip[0] & 0x0f) << 2) - %1)").arg(payloadOffset);
+    const QString padding = QString("(%1 = 6 and (tcp[tcpflags] & tcp-push) = 0 and tcp[%2:4] = 0 and tcp[%2 + 4:2] = 0)")
+        .arg(payloadSize, payloadOffset)
+    ;
+
+    // Server -> client payload of known flows, connection state changes of any flow
+    return QString("tcp src port %1 and ((tcp[tcpflags] & (tcp-syn|tcp-fin|tcp-rst)) != 0 or ((%2) and %3 > 0 and not %4))")
+        .arg(m_port)
+        .arg(flows.join(" or "), payloadSize, padding)
+        .toLatin1()
+    ;
+}
+
+void PacketCapture::processPacket(const uint8_t *packet, qsizetype len, int64_t timestamp)
 {
     if (len < sizeof(iphdr))
     {
         qCritical() << "Packet too short";
         return;
     }
+    m_nPackets.fetch_add(1, memory_order_relaxed);
+
+    if (m_recorder)
+        m_recorder->add(packet, len, timestamp);
+
+    if (m_packetForwarder)
+    {
+        m_packetForwarder(packet, len, timestamp);
+        return;
+    }
+
     const auto ipHeader = reinterpret_cast<const iphdr *>(packet);
     packet += ipHeader->ihl * sizeof(uint32_t);
     len -= ipHeader->ihl * sizeof(uint32_t);
@@ -118,50 +262,59 @@ void PacketCapture::processPacket(const uint8_t *packet, qsizetype len)
         return;
     }
 
-    const uint32_t srcIp = ntohl(ipHeader->saddr);
-    const uint32_t dstIp = ntohl(ipHeader->daddr);
-    const uint16_t dstPort = ntohs(tcpHeader->dest);
+    const FlowKey key {
+        ntohl(ipHeader->saddr),
+        ntohl(ipHeader->daddr),
+        ntohs(tcpHeader->source),
+        ntohs(tcpHeader->dest),
+    };
     const uint32_t seq = ntohl(tcpHeader->seq);
 
-    if (!m_hasConnection || tcpHeader->syn)
-    {
-#ifdef QT_DEBUG
-        if (tcpHeader->syn)
-            qDebug() << "TCP connection started";
-#endif
-        m_hasConnection = true;
-        m_srcIp = srcIp;
-        m_dstIp = dstIp;
-        m_dstPort = dstPort;
-        m_seq = seq + (tcpHeader->syn ? 1 : 0);
-        m_reassembly.clear();
-    }
+    if (key.srcPort != m_port)
+        return; // Client -> server, the decoder knows the server messages only
 
-    if (m_srcIp != srcIp || m_dstIp != dstIp)
+    // Flow timeouts follow the capture clock, so replayed files behave like live traffic
+    const int64_t time = timestamp / 1'000'000;
+    if (time - m_lastIdleCheck >= g_flowIdleCheckInterval)
     {
-#ifdef QT_DEBUG
-        qDebug() << "Ignoring different IP (connections with more servers?)";
-#endif
-        return;
+        m_flows.removeIdle(time, g_flowIdleTimeout);
+        m_lastIdleCheck = time;
     }
 
-    if (m_dstPort != dstPort)
+    auto flow = m_flows.find(key);
+
+    if (tcpHeader->fin || tcpHeader->rst)
     {
+        if (flow)
+        {
 #ifdef QT_DEBUG
-        qDebug() << "Ignoring different TCP destination port (too many connections with server?)";
+            qDebug() << "TCP connection finished / reset, flow:" << m_flows.getId(*flow);
 #endif
+            m_flows.remove(*flow);
+        }
         return;
     }
 
-    if (tcpHeader->fin || tcpHeader->rst)
+    if (!flow || tcpHeader->syn)
     {
+        if (!flow)
+        {
+            flow = &m_flows.insert(key, time);
+            m_flowsChanged = true;
+        }
+        else
+        {
+            // Same addresses and ports reused by a new connection
+            emit flowReset(m_flows.getId(*flow));
+        }
 #ifdef QT_DEBUG
-        qDebug() << "TCP connection finished / reset";
+        qDebug() << (tcpHeader->syn ? "TCP connection started, flow:" : "TCP connection joined, flow:") << m_flows.getId(*flow);
 #endif
-        reset();
-        return;
+        flow->reassembly.reset(seq + (tcpHeader->syn ? 1 : 0));
     }
 
+    flow->lastSeen = time;
+
     if (!tcpHeader->psh && len == 6 && memcmp(packet, "\0\0\0\0\0", 6) == 0)
     {
         // 6 bytes is padding here
@@ -173,53 +326,20 @@ void PacketCapture::processPacket(const uint8_t *packet, qsizetype len)
         return;
     }
 
-    if (!maybeNewPacket(seq, packet, len, true))
-    {
-        auto &[storedSeq, arr] = m_reassembly.emplace_back();
-        storedSeq = seq;
-        arr.insert(arr.begin(), packet, packet + len);
+    m_nPayloadPackets.fetch_add(1, memory_order_relaxed);
 
+    const uint32_t flowId = m_flows.getId(*flow);
+    flow->reassembly.push(seq, packet, len, time,
+        [&](const uint8_t *data, uint32_t size) {
+            emit newPacket(flowId, data, size, timestamp);
+        },
+        [&](uint32_t lostBytes) {
 #ifdef QT_DEBUG
-        qDebug() << "TCP packet buffered for reassembly, seq:" << seq;
-#endif
-
-        return;
-    }
-
-    if (!m_reassembly.empty())
-    {
-        for (auto &&[storedSeq, arr] : m_reassembly)
-        {
-            maybeNewPacket(storedSeq, arr.data(), arr.size(), false);
-        }
-        m_reassembly.clear();
-#ifdef QT_DEBUG
-        qDebug() << "Cleared all buffered TCP packets";
-#endif
-    }
-}
-
-bool PacketCapture::maybeNewPacket(uint32_t seq, const uint8_t *data, uint32_t dataSize, bool currPkt)
-{
-    // FIXME: What if sequence integer overflows?
-
-    if (m_seq < seq || m_seq >= seq + dataSize)
-        return false;
-
-    const uint32_t seqDiff = m_seq - seq;
-
-#ifdef QT_DEBUG
-    if (!currPkt)
-        qDebug() << "TCP packet reassembly finished, seq:" << seq << "+" << seqDiff;
-    else if (seqDiff > 0)
-        qDebug() << "TCP packet with offset, seq:" << seq << "+" << seqDiff;
+            qDebug() << "TCP data lost, flow:" << flowId << "bytes:" << lostBytes;
 #else
-    Q_UNUSED(currPkt)
+            Q_UNUSED(lostBytes)
 #endif
-
-    const auto size = dataSize - seqDiff;
-    emit newPacket(data + seqDiff, size);
-    m_seq += size;
-
-    return true;
+            emit flowReset(flowId);
+        }
+    );
 }
@@ -1,13 +1,42 @@
 #pragma once
 
+#include "FlowTable.hpp"
+
+class PacketRecorder;
+
+#include <QElapsedTimer>
 #include <QObject>
 
+#include <atomic>
+#include <functional>
+
 class PacketCapture : public QObject
 {
     Q_OBJECT
 
 public:
-    static std::unique_ptr<PacketCapture> create();
+    enum class Backend
+    {
+        Default,
+        PCap,
+        TPacketV3,
+    };
+
+    // Live capture tuning, latency vs throughput
+    struct Options
+    {
+        bool immediateMode = false; // Deliver packets as soon as they arrive, no read timeout batching
+        int bufferSize = 0; // Kernel buffer in bytes, 0 = backend default
+        int snapLen = 65535;
+        bool nanoTimestamps = false;
+    };
+
+    // Whole IPv4 packets, for receivers with their own flow tracking
+    using PacketForwarder = std::function<void(const uint8_t *packet, qsizetype len, int64_t timestamp)>;
+
+    static std::unique_ptr<PacketCapture> create(Backend backend = Backend::Default);
+    static std::unique_ptr<PacketCapture> create(Backend backend, const Options &options);
+    static std::unique_ptr<PacketCapture> createReplay(const QString &fileName, double speed);
 
 public:
     PacketCapture();
@@ -17,20 +46,73 @@ public:
 
     void reset();
 
+    void setDynamicFilter(bool dynamicFilter);
+
+    // Every packet reaching this class is recorded, set before the capture starts
+    void setRecorder(PacketRecorder *recorder);
+
+    // Packets are handed over instead of being reassembled here, no flows are tracked and
+    // "newPacket()" is not emitted, set before the capture starts
+    void setPacketForwarder(const PacketForwarder &packetForwarder);
+
+    // Capture thread only, reads the kernel drop counter now instead of with the next batch
+    void updateNumDrops();
+
+    inline uint64_t getNumPackets() const;
+    inline uint64_t getNumPayloadPackets() const;
+    inline uint64_t getNumFilterUpdates() const;
+    inline uint64_t getNumDrops() const; // Kernel drops, at most a second old while packets arrive
+
 protected:
-    virtual void processPacket(const uint8_t *packet, qsizetype len);
+    // Timestamp in nanoseconds since epoch, as reported by the capture source
+    virtual void processPacket(const uint8_t *packet, qsizetype len, int64_t timestamp);
 
-private:
-    bool maybeNewPacket(uint32_t seq, const uint8_t *data, uint32_t dataSize, bool currPkt);
+    // Backends call it after a batch of packets, calls "updateFilter()" if the set of flows changed
+    // and refreshes the drop counter once a second
+    void flushFlowChanges();
+    virtual void updateFilter();
+
+    // Called from the capture thread only, the handles of the backends aren't thread safe
+    virtual uint64_t readNumDrops();
+
+    QByteArray makeFilter() const;
 
 signals:
-    void newPacket(const uint8_t *data, qsizetype len); // Must be direct connection
+    void newPacket(uint32_t flowId, const uint8_t *data, qsizetype len, int64_t timestamp); // Must be direct connection
+    void flowReset(uint32_t flowId); // Flow closed or data lost, must be direct connection
+    void finished(); // End of capture file reached
+
+protected:
+    uint16_t m_port = 0;
 
 private:
-    bool m_hasConnection = false;
-    uint32_t m_srcIp = 0;
-    uint32_t m_dstIp = 0;
-    uint16_t m_dstPort = 0;
-    uint32_t m_seq = 0;
-    std::vector<std::pair<uint32_t, std::vector<uint8_t>>> m_reassembly;
+    FlowTable m_flows;
+    bool m_flowsChanged = false;
+    bool m_dynamicFilter = true;
+    PacketRecorder *m_recorder = nullptr;
+    PacketForwarder m_packetForwarder;
+    int64_t m_lastIdleCheck = 0;
+    QElapsedTimer m_dropsTimer;
+
+    std::atomic<uint64_t> m_nPackets {0};
+    std::atomic<uint64_t> m_nPayloadPackets {0};
+    std::atomic<uint64_t> m_nFilterUpdates {0};
+    std::atomic<uint64_t> m_nDrops {0};
 };
+
+inline uint64_t PacketCapture::getNumPackets() const
+{
+    return m_nPackets.load(std::memory_order_relaxed);
+}
+inline uint64_t PacketCapture::getNumPayloadPackets() const
+{
+    return m_nPayloadPackets.load(std::memory_order_relaxed);
+}
+inline uint64_t PacketCapture::getNumFilterUpdates() const
+{
+    return m_nFilterUpdates.load(std::memory_order_relaxed);
+}
+inline uint64_t PacketCapture::getNumDrops() const
+{
+    return m_nDrops.load(std::memory_order_relaxed);
+}
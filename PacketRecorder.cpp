@@ -0,0 +1,290 @@
+#include "PacketRecorder.hpp"
+
+#include <QDateTime>
+#include <QThread>
+#include <QDir>
+#include <QDebug>
+
+#include <cstring>
+
+using namespace std;
+
+constexpr size_t g_chunkSize = 256 << 10;
+constexpr size_t g_nChunks = 16;
+constexpr int64_t g_maxChunkAge = 1'000'000'000; // ns, don't keep a slow trickle of packets in memory
+constexpr unsigned long g_writerIdleSleep = 20; // ms
+
+// pcapng, host byte order (readers detect it from the byte-order magic)
+
+constexpr uint32_t g_sectionHeaderBlock = 0x0a0d0d0a;
+constexpr uint32_t g_interfaceDescriptionBlock = 0x00000001;
+constexpr uint32_t g_enhancedPacketBlock = 0x00000006;
+constexpr uint16_t g_linkTypeRaw = 101; // LINKTYPE_RAW, packets start at the IP header
+
+#pragma pack(1)
+
+struct SectionHeaderBlock
+{
+    uint32_t type;
+    uint32_t length;
+    uint32_t byteOrderMagic;
+    uint16_t majorVersion;
+    uint16_t minorVersion;
+    int64_t sectionLength;
+    uint32_t length2;
+};
+static_assert(sizeof(SectionHeaderBlock) == 28);
+
+struct InterfaceDescriptionBlock
+{
+    uint32_t type;
+    uint32_t length;
+    uint16_t linkType;
+    uint16_t reserved;
+    uint32_t snapLen;
+    uint16_t tsresolCode;
+    uint16_t tsresolLength;
+    uint8_t tsresol;
+    uint8_t tsresolPadding[3];
+    uint16_t endOfOptionsCode;
+    uint16_t endOfOptionsLength;
+    uint32_t length2;
+};
+static_assert(sizeof(InterfaceDescriptionBlock) == 32);
+
+struct EnhancedPacketBlockHeader
+{
+    uint32_t type;
+    uint32_t length;
+    uint32_t interfaceId;
+    uint32_t timestampHigh;
+    uint32_t timestampLow;
+    uint32_t capturedLength;
+    uint32_t originalLength;
+};
+static_assert(sizeof(EnhancedPacketBlockHeader) == 28);
+
+#pragma pack()
+
+/**/
+
+PacketRecorder::PacketRecorder(const Options &options)
+    : m_options(options)
+    , m_fullChunks(g_nChunks)
+    , m_freeChunks(g_nChunks)
+{
+    for (size_t i = 0; i < g_nChunks; ++i)
+    {
+        auto chunk = make_unique<Chunk>();
+        chunk->data = make_unique<uint8_t[]>(g_chunkSize);
+        m_freeChunks.push(chunk.get());
+        m_chunks.push_back(move(chunk));
+    }
+}
+PacketRecorder::~PacketRecorder()
+{
+    if (m_thread)
+    {
+        // The capture thread is gone, so the last chunk can be handed over from here
+        submit();
+
+        m_thread->requestInterruption();
+        m_thread->wait();
+        delete m_thread;
+    }
+}
+
+bool PacketRecorder::start()
+{
+    if (!QDir().mkpath(m_options.directory))
+    {
+        qCritical() << "Can't create recording directory:" << m_options.directory;
+        return false;
+    }
+
+    m_thread = QThread::create(bind(&PacketRecorder::writerThread, this));
+    m_thread->setObjectName("PacketRecorder");
+    m_thread->start(QThread::LowPriority);
+
+    return true;
+}
+
+void PacketRecorder::add(const uint8_t *packet, qsizetype len, int64_t timestamp)
+{
+    const size_t paddedLen = (len + 3) & ~3;
+    const size_t blockLen = sizeof(EnhancedPacketBlockHeader) + paddedLen + sizeof(uint32_t);
+
+    if (blockLen > g_chunkSize)
+    {
+        m_nDrops.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+
+    if (m_rotateRequested.load(memory_order_relaxed) && m_rotateRequested.exchange(false, memory_order_relaxed))
+    {
+        submit();
+        m_newFile = true;
+    }
+
+    if (m_chunk && (m_chunk->size + blockLen > g_chunkSize || timestamp - m_chunk->firstTimestamp > g_maxChunkAge))
+        submit();
+
+    if (!m_chunk)
+    {
+        if (!m_freeChunks.pop(m_chunk))
+        {
+            m_nDrops.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        m_chunk->size = 0;
+        m_chunk->firstTimestamp = timestamp;
+        m_chunk->newFile = m_newFile;
+        m_newFile = false;
+    }
+
+    uint8_t *dst = m_chunk->data.get() + m_chunk->size;
+
+    EnhancedPacketBlockHeader header = {};
+    header.type = g_enhancedPacketBlock;
+    header.length = blockLen;
+    header.interfaceId = 0;
+    header.timestampHigh = static_cast<uint64_t>(timestamp) >> 32;
+    header.timestampLow = static_cast<uint64_t>(timestamp);
+    header.capturedLength = len;
+    header.originalLength = len;
+    memcpy(dst, &header, sizeof(header));
+    dst += sizeof(header);
+
+    memcpy(dst, packet, len);
+    memset(dst + len, 0, paddedLen - len);
+    dst += paddedLen;
+
+    const uint32_t length2 = blockLen;
+    memcpy(dst, &length2, sizeof(length2));
+
+    m_chunk->size += blockLen;
+
+    m_nPackets.fetch_add(1, memory_order_relaxed);
+}
+
+void PacketRecorder::rotate()
+{
+    m_rotateRequested.store(true, memory_order_relaxed);
+}
+
+void PacketRecorder::submit()
+{
+    if (!m_chunk)
+        return;
+
+    // Can't fail, there are never more chunks than ring slots
+    m_fullChunks.push(m_chunk);
+    m_chunk = nullptr;
+}
+
+void PacketRecorder::writerThread()
+{
+    for (;;)
+    {
+        const bool interrupted = m_thread->isInterruptionRequested();
+
+        Chunk *chunk = nullptr;
+        bool written = false;
+        while (m_fullChunks.pop(chunk))
+        {
+            write(*chunk);
+            m_freeChunks.push(chunk);
+            written = true;
+        }
+
+        if (interrupted)
+            break;
+
+        if (written)
+            m_file.flush();
+        else
+            QThread::msleep(g_writerIdleSleep);
+    }
+
+    m_file.close();
+}
+
+void PacketRecorder::write(Chunk &chunk)
+{
+    if (chunk.size == 0)
+        return;
+
+    const bool sizeExceeded = (m_file.isOpen() && m_file.size() + static_cast<int64_t>(chunk.size) > m_options.maxFileSize);
+    if (!m_file.isOpen() || chunk.newFile || sizeExceeded)
+    {
+        if (!openNextFile())
+            return;
+    }
+
+    if (m_file.write(reinterpret_cast<const char *>(chunk.data.get()), chunk.size) != static_cast<int64_t>(chunk.size))
+    {
+        if (!m_writeError)
+            qWarning() << "Can't write recording:" << m_file.errorString();
+        m_writeError = true;
+        return;
+    }
+
+    m_nBytesWritten.fetch_add(chunk.size, memory_order_relaxed);
+}
+
+bool PacketRecorder::openNextFile()
+{
+    m_file.close();
+
+    const uint32_t fileIdx = m_nFiles.load(memory_order_relaxed);
+    const auto fileName = QDir(m_options.directory).filePath(QString("MiluDpsMeter-%1-%2.pcapng")
+        .arg(QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss"))
+        .arg(fileIdx, 4, 10, QChar('0'))
+    );
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        if (!m_writeError)
+            qWarning() << "Can't create recording:" << m_file.errorString();
+        m_writeError = true;
+        return false;
+    }
+    m_writeError = false;
+
+    SectionHeaderBlock shb = {};
+    shb.type = g_sectionHeaderBlock;
+    shb.length = sizeof(shb);
+    shb.byteOrderMagic = 0x1a2b3c4d;
+    shb.majorVersion = 1;
+    shb.minorVersion = 0;
+    shb.sectionLength = -1;
+    shb.length2 = sizeof(shb);
+
+    InterfaceDescriptionBlock idb = {};
+    idb.type = g_interfaceDescriptionBlock;
+    idb.length = sizeof(idb);
+    idb.linkType = g_linkTypeRaw;
+    idb.snapLen = 0; // No limit
+    idb.tsresolCode = 9; // if_tsresol
+    idb.tsresolLength = 1;
+    idb.tsresol = 9; // Nanoseconds
+    idb.length2 = sizeof(idb);
+
+    m_file.write(reinterpret_cast<const char *>(&shb), sizeof(shb));
+    m_file.write(reinterpret_cast<const char *>(&idb), sizeof(idb));
+
+    m_fileNames += fileName;
+    m_nFiles.fetch_add(1, memory_order_relaxed);
+
+    if (m_options.maxFiles > 0)
+    {
+        while (m_fileNames.size() > m_options.maxFiles)
+        {
+            QFile::remove(m_fileNames.front());
+            m_fileNames.removeFirst();
+        }
+    }
+
+    return true;
+}
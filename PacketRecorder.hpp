@@ -0,0 +1,97 @@
+#pragma once
+
+#include "SpscRing.hpp"
+
+#include <QFile>
+#include <QStringList>
+
+#include <atomic>
+#include <vector>
+
+class QThread;
+
+// Writes packets seen by the capture thread to pcapng files on a background thread
+class PacketRecorder
+{
+public:
+    struct Options
+    {
+        QString directory;
+        int64_t maxFileSize = 100ll << 20; // Bytes, rotate when exceeded
+        int maxFiles = 10; // Oldest files of this session are deleted, 0 = keep all
+    };
+
+public:
+    PacketRecorder(const Options &options);
+    ~PacketRecorder();
+
+    bool start();
+
+    // Capture thread only, never blocks, the packet is dropped when the writer can't keep up
+    void add(const uint8_t *packet, qsizetype len, int64_t timestamp);
+
+    // Any thread, the next packet starts a new file
+    void rotate();
+
+    // Any thread
+    inline uint64_t getNumPackets() const;
+    inline uint64_t getNumDrops() const;
+    inline uint64_t getNumBytesWritten() const;
+    inline uint32_t getNumFiles() const;
+
+private:
+    struct Chunk
+    {
+        std::unique_ptr<uint8_t[]> data;
+        size_t size = 0;
+        int64_t firstTimestamp = 0;
+        bool newFile = false;
+    };
+
+    void submit();
+
+    void writerThread();
+    void write(Chunk &chunk);
+    bool openNextFile();
+
+private:
+    const Options m_options;
+
+    std::vector<std::unique_ptr<Chunk>> m_chunks;
+    SpscRing<Chunk *> m_fullChunks; // Capture thread -> writer
+    SpscRing<Chunk *> m_freeChunks; // Writer -> capture thread
+
+    // Capture thread
+    Chunk *m_chunk = nullptr;
+    bool m_newFile = true;
+
+    std::atomic_bool m_rotateRequested {false};
+
+    // Writer thread
+    QThread *m_thread = nullptr;
+    QFile m_file;
+    QStringList m_fileNames;
+    bool m_writeError = false;
+
+    std::atomic<uint64_t> m_nPackets {0};
+    std::atomic<uint64_t> m_nDrops {0};
+    std::atomic<uint64_t> m_nBytesWritten {0};
+    std::atomic<uint32_t> m_nFiles {0};
+};
+
+inline uint64_t PacketRecorder::getNumPackets() const
+{
+    return m_nPackets.load(std::memory_order_relaxed);
+}
+inline uint64_t PacketRecorder::getNumDrops() const
+{
+    return m_nDrops.load(std::memory_order_relaxed);
+}
+inline uint64_t PacketRecorder::getNumBytesWritten() const
+{
+    return m_nBytesWritten.load(std::memory_order_relaxed);
+}
+inline uint32_t PacketRecorder::getNumFiles() const
+{
+    return m_nFiles.load(std::memory_order_relaxed);
+}
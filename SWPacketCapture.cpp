@@ -4,6 +4,9 @@
 #include <QtEndian>
 #include <QDebug>
 
+#include <array>
+#include <limits>
+
 using namespace std;
 using namespace Packet;
 
@@ -11,229 +14,379 @@ constexpr auto g_headerSize = sizeof(Header);
 
 SWPacketCapture::SWPacketCapture(QObject *parent)
     : QObject(parent)
+    , m_payload(make_unique<uint8_t[]>(numeric_limits<decltype(Header::size)>::max()))
 {
+    m_events.reserve(256);
 }
 SWPacketCapture::~SWPacketCapture()
 {
 }
 
-void SWPacketCapture::newPacket(const uint8_t *data, qsizetype len)
+void SWPacketCapture::setEventConsumer(const EventConsumer &eventConsumer)
+{
+    m_eventConsumer = eventConsumer;
+}
+
+void SWPacketCapture::setLazyDecrypt(bool lazyDecrypt)
+{
+    m_lazyDecrypt = lazyDecrypt;
+}
+
+void SWPacketCapture::newPacket(uint32_t flowId, const uint8_t *data, qsizetype len, int64_t timestamp)
 {
-    while (len > 0)
+    m_timestamp = timestamp;
+    m_nBytes.fetch_add(len, memory_order_relaxed);
+
+    processSegment(flowId, data, len);
+    flushEvents();
+}
+
+void SWPacketCapture::processSegment(uint32_t flowId, const uint8_t *data, qsizetype len)
+{
+    auto &buffer = m_buffers[flowId];
+
+    if (!buffer.empty())
     {
-        if (m_data.size() < g_headerSize)
+        // Finish the packet which started in a previous segment
+        const auto bufferedSize = buffer.size();
+
+        if (buffer.size() < g_headerSize)
         {
-            const auto toReserve = max<qsizetype>(len, g_headerSize);
-            if (m_data.capacity() < toReserve)
-                m_data.reserve(toReserve);
+            const auto toCopy = min<qsizetype>(len, g_headerSize - buffer.size());
+            buffer.insert(buffer.end(), data, data + toCopy);
+            data += toCopy;
+            len -= toCopy;
+        }
 
-            const int toCopy = min<qsizetype>(len, g_headerSize);
-            m_data.insert(m_data.end(), data, data + toCopy);
+        if (buffer.size() >= g_headerSize)
+        {
+            const auto header = reinterpret_cast<const Header *>(buffer.data());
+            if (!isValidHeader(*header))
+            {
+                buffer.clear();
+                return;
+            }
+
+            const auto toCopy = min<qsizetype>(len, header->size - buffer.size());
+            buffer.insert(buffer.end(), data, data + toCopy);
             data += toCopy;
             len -= toCopy;
         }
 
-        if (m_data.size() < g_headerSize)
+        m_nCopiedBytes.fetch_add(buffer.size() - bufferedSize, memory_order_relaxed);
+
+        if (buffer.size() < g_headerSize || buffer.size() < reinterpret_cast<const Header *>(buffer.data())->size)
         {
 #ifdef QT_DEBUG
-            qDebug() << "Segmented packet, waiting for header:" << m_data.size();
+            qDebug() << "Segmented packet:" << buffer.size();
 #endif
-            break;
+            return;
         }
 
-        auto header = reinterpret_cast<const Header *>(m_data.data());
+        processPacket(buffer.data(), buffer.size());
+        buffer.clear();
+    }
 
-        if (header->magic != 2)
-        {
+    // Packets which are entirely in this segment are parsed in place
+    while (len >= g_headerSize)
+    {
+        const auto header = reinterpret_cast<const Header *>(data);
+        if (!isValidHeader(*header))
+            return;
+
+        if (header->size > len)
+            break;
+
+        processPacket(data, header->size);
+        data += header->size;
+        len -= header->size;
+    }
+
+    if (len > 0)
+    {
 #ifdef QT_DEBUG
-            qWarning() << "Invalid packet:" << header->magic;
+        qDebug() << "Segmented packet, buffered:" << len;
 #endif
-            m_data.clear();
-            break;
-        }
+        buffer.assign(data, data + len);
+        m_nCopiedBytes.fetch_add(len, memory_order_relaxed);
+    }
+}
 
-        if (m_data.capacity() < header->size)
-        {
-            m_data.reserve(header->size);
-            header = reinterpret_cast<const Header *>(m_data.data());
-        }
+void SWPacketCapture::flushEvents()
+{
+    if (m_events.empty())
+        return;
 
-        const int toCopy = min<qsizetype>(len, header->size - m_data.size());
-        if (toCopy > 0)
-        {
-            m_data.insert(m_data.end(), data, data + toCopy);
-            data += toCopy;
-            len -= toCopy;
-        }
+    if (m_eventConsumer)
+        m_eventConsumer(m_events.data(), m_events.size());
+    m_events.clear();
+}
 
-        if (m_data.size() < header->size)
-        {
+void SWPacketCapture::resetFlow(uint32_t flowId)
+{
+    auto &buffer = m_buffers[flowId];
+    buffer.clear();
+    buffer.shrink_to_fit();
+}
+
+bool SWPacketCapture::isValidHeader(const Header &header)
+{
+    if (header.magic != 2)
+    {
 #ifdef QT_DEBUG
-            qDebug() << "Segmented packet:" << m_data.size() << header->size;
+        qWarning() << "Invalid packet:" << header.magic;
 #endif
-            break;
-        }
+        return false;
+    }
+    if (header.size < g_headerSize)
+    {
+#ifdef QT_DEBUG
+        qWarning() << "Invalid packet size:" << header.size;
+#endif
+        return false;
+    }
+    return true;
+}
 
-        if (header->type != 1)
-        {
-            m_data.clear();
-            continue;
-        }
+void SWPacketCapture::processPacket(const uint8_t *packet, qsizetype len)
+{
+    const auto header = reinterpret_cast<const Header *>(packet);
+    if (header->type != 1)
+        return;
 
-        qsizetype dataSize = header->size - sizeof(Header);
-        if (dataSize < sizeof(uint16_t))
-        {
+    qsizetype dataSize = len - sizeof(Header);
+    if (dataSize < sizeof(uint16_t))
+    {
 #ifdef QT_DEBUG
-            qWarning() << "Packet too short";
+        qWarning() << "Packet too short";
 #endif
-            m_data.clear();
-            break;
-        }
+        return;
+    }
+    m_nPayloadBytes.fetch_add(dataSize, memory_order_relaxed);
 
-        auto data = m_data.data() + sizeof(Header);
+    const uint8_t *data = packet + sizeof(Header);
 
-        decrypt(data, dataSize);
+    OpCode op;
+    if (m_lazyDecrypt)
+    {
+        op = static_cast<OpCode>(qFromBigEndian(XorDecrypt::decryptValue<uint16_t>(data, 0)));
+        m_nDecryptedBytes.fetch_add(sizeof(OpCode), memory_order_relaxed);
+    }
+    else
+    {
+        // Source is read-only, decrypt into the payload buffer
+        XorDecrypt::decrypt(m_payload.get(), data, dataSize);
+        m_nDecryptedBytes.fetch_add(dataSize, memory_order_relaxed);
 
-        const auto op = static_cast<OpCode>(qbswap(*reinterpret_cast<const uint16_t *>(data)));
-        data += sizeof(OpCode);
-        dataSize -= sizeof(OpCode);
+        data = m_payload.get();
+        op = static_cast<OpCode>(qFromBigEndian<uint16_t>(data));
+    }
 
-        switch (op)
-        {
-            case OpCode::WorldChange:
-                processWorldChangePacket(data, dataSize);
-                break;
-            case OpCode::ObjectCreate:
-                processObjectCreatePacket(data, dataSize);
-                break;
-            case OpCode::Damage:
-                processDamagePacket(data, dataSize);
-                break;
-            case OpCode::Akasic:
-                processAkasicPacket(data, dataSize);
-                break;
-            case OpCode::MazeEnd:
-                emit mazeEnd();
-                break;
-            case OpCode::Party:
-            case OpCode::Force:
-                processPartyPacket(data, dataSize);
-                break;
-            default:
-            {
-#if defined(QT_DEBUG) && 0
-                const auto opInt = static_cast<uint16_t>(op);
-                if (opInt != 0x0106)
-                {
-                    qDebug().noquote().nospace() << QString("0x%1").arg(opInt, 4, 16, QLatin1Char('0')) << ", size: " << dataSize;
-                }
-#endif
-                break;
-            }
-        }
+    const Payload payload(data + sizeof(OpCode), dataSize - sizeof(OpCode), m_lazyDecrypt, sizeof(OpCode));
+
+    const auto handler = getHandler(op);
 
-        m_data.clear();
+    if (m_profiler.add(static_cast<uint16_t>(op), dataSize, handler != nullptr))
+    {
+        uint8_t sample[OpCodeProfiler::s_maxSampleSize];
+        payload.read(sample, 0, min<qsizetype>(payload.size(), sizeof(sample)));
+        m_profiler.addSample(static_cast<uint16_t>(op), m_timestamp, sample, payload.size());
     }
+
+    if (handler)
+        (this->*handler)(payload);
+
+    if (m_lazyDecrypt)
+        m_nDecryptedBytes.fetch_add(payload.getNumDecryptedBytes(), memory_order_relaxed);
 }
 
-void SWPacketCapture::decrypt(uint8_t *data, qsizetype size)
+namespace {
+
+// Opcode -> 1-based index into the handler list, 0 for unknown opcodes
+template <size_t N>
+constexpr auto makeDispatchTable(const OpCode (&opCodes)[N])
 {
-    constexpr uint8_t xorTable[3] = {0x60, 0x3B, 0x0B};
+    static_assert(N < 256);
+    std::array<uint8_t, numeric_limits<uint16_t>::max() + 1> table = {};
+    for (size_t i = 0; i < N; ++i)
+        table[static_cast<uint16_t>(opCodes[i])] = i + 1;
+    return table;
+}
+
+template <size_t N>
+constexpr bool hasUniqueOpCodes(const OpCode (&opCodes)[N])
+{
+    for (size_t i = 0; i < N; ++i)
+    {
+        for (size_t j = i + 1; j < N; ++j)
+        {
+            if (opCodes[i] == opCodes[j])
+                return false;
+        }
+    }
+    return true;
+}
+
+}
 
-    for (qsizetype i = 0; i < size; ++i)
-        data[i] ^= xorTable[i % sizeof(xorTable)];
+SWPacketCapture::Handler SWPacketCapture::getHandler(OpCode op)
+{
+    // Dense table generated at compile time, adding messages doesn't add branches
+    static constexpr OpCode opCodes[] = {
+        WorldChange::opCode,
+        ObjectCreate::opCode,
+        Damage::opCode,
+        Akasic::opCode,
+        MazeEnd::opCode,
+        Party::opCode,
+        Force::opCode,
+    };
+    static constexpr Handler handlers[] = {
+        &SWPacketCapture::processWorldChangePacket,
+        &SWPacketCapture::processObjectCreatePacket,
+        &SWPacketCapture::processDamagePacket,
+        &SWPacketCapture::processAkasicPacket,
+        &SWPacketCapture::processMazeEndPacket,
+        &SWPacketCapture::processPartyPacket,
+        &SWPacketCapture::processPartyPacket,
+    };
+    static_assert(size(opCodes) == size(handlers));
+    static_assert(hasUniqueOpCodes(opCodes));
+
+    static constexpr auto table = makeDispatchTable(opCodes);
+
+    const auto idx = table[static_cast<uint16_t>(op)];
+    return (idx > 0) ? handlers[idx - 1] : nullptr;
 }
 
-void SWPacketCapture::processWorldChangePacket(uint8_t *data, qsizetype len)
+void SWPacketCapture::processWorldChangePacket(const Payload &payload)
 {
-    if (len < sizeof(WorldChange))
+    const Record<WorldChange> packet(payload, 0);
+    if (!packet)
         return;
 
-    const auto packet = reinterpret_cast<const WorldChange *>(data);
-    emit worldChange(packet->id, packet->worldId);
+    auto &event = addEvent(DpsEvent::Type::WorldChange);
+    event.worldChange.id = packet.get<WorldChange::Id>();
+    event.worldChange.worldId = packet.get<WorldChange::WorldId>();
 }
-void SWPacketCapture::processObjectCreatePacket(uint8_t *data, qsizetype len)
+void SWPacketCapture::processObjectCreatePacket(const Payload &payload)
 {
-    if (len < sizeof(ObjectCreate))
+    const Record<ObjectCreate> packet(payload, 0);
+    if (!packet)
         return;
 
-    const auto packet = reinterpret_cast<const ObjectCreate *>(data);
-    emit ownerId(packet->id, packet->owner_id);
+    auto &event = addEvent(DpsEvent::Type::OwnerId);
+    event.ownerId.id = packet.get<ObjectCreate::Id>();
+    event.ownerId.ownerId = packet.get<ObjectCreate::OwnerId>();
 }
-void SWPacketCapture::processDamagePacket(uint8_t *data, qsizetype len)
+void SWPacketCapture::processDamagePacket(const Payload &payload)
 {
-    if (len < sizeof(uint8_t))
+    const Record<Damage> packet(payload, 0);
+    if (!packet)
         return;
 
-    const auto nMonsters = data[0];
-    data += sizeof(uint8_t);
-    len -= sizeof(uint8_t);
+    const auto nMonsters = packet.get<Damage::MonsterCount>();
 
-    if (len < sizeof(DamageMonster) * nMonsters + sizeof(DamagePlayer))
+    const Record<DamagePlayer> damagePlayer(payload, packet.end() + DamageMonster::size * nMonsters);
+    if (!damagePlayer)
         return;
 
-    const auto damagePlayer = reinterpret_cast<const DamagePlayer *>(data + sizeof(DamageMonster) * nMonsters);
+    const auto playerId = damagePlayer.get<DamagePlayer::PlayerId>();
+    const auto skillId = damagePlayer.get<DamagePlayer::SkillId>();
+    const auto maxCombo = damagePlayer.get<DamagePlayer::MaxCombo>();
 
     for (uint32_t i = 0; i < nMonsters; ++i)
     {
-        const auto damageMonster = reinterpret_cast<const DamageMonster *>(data);
-        data += sizeof(DamageMonster);
-        len -= sizeof(DamageMonster);
-
-        const bool isMiss = (damageMonster->damageType & 0x01);
-        const bool isCrit = (damageMonster->damageType & 0x04);
-        emit damage(
-            damagePlayer->playerId,
-            damagePlayer->maxCombo,
-            damageMonster->monsterId,
-            damageMonster->totalDmg,
-            damageMonster->soulstoneDmg,
-            isMiss,
-            isCrit
-        );
+        // Within bounds, the player record after the monsters fits
+        const Record<DamageMonster> damageMonster(payload, packet.end() + DamageMonster::size * i);
+
+        const auto damageType = damageMonster.get<DamageMonster::DamageType>();
+
+        auto &event = addEvent(DpsEvent::Type::Damage);
+        event.damage.srcId = playerId;
+        event.damage.dstId = damageMonster.get<DamageMonster::MonsterId>();
+        event.damage.dmg = damageMonster.get<DamageMonster::TotalDmg>();
+        event.damage.ssDmg = damageMonster.get<DamageMonster::SoulstoneDmg>();
+        event.damage.skillId = skillId;
+        event.damage.remainHp = damageMonster.get<DamageMonster::RemainHp>();
+        event.damage.combo = maxCombo;
+        event.damage.miss = (damageType & 0x01);
+        event.damage.crit = (damageType & 0x04);
     }
 }
-void SWPacketCapture::processAkasicPacket(uint8_t *data, qsizetype len)
+void SWPacketCapture::processAkasicPacket(const Payload &payload)
 {
-    if (len < sizeof(Akasic))
+    const Record<Akasic> packet(payload, 0);
+    if (!packet)
         return;
 
-    const auto packet = reinterpret_cast<const Akasic *>(data);
-    emit ownerId(packet->id, packet->owner_id);
+    auto &event = addEvent(DpsEvent::Type::OwnerId);
+    event.ownerId.id = packet.get<Akasic::Id>();
+    event.ownerId.ownerId = packet.get<Akasic::OwnerId>();
+}
+void SWPacketCapture::processMazeEndPacket(const Payload &payload)
+{
+    Q_UNUSED(payload)
+    addEvent(DpsEvent::Type::MazeEnd);
 }
-void SWPacketCapture::processPartyPacket(uint8_t *data, qsizetype len)
+void SWPacketCapture::processPartyPacket(const Payload &payload)
 {
-    if (len < sizeof(PartyHeader))
+    const Record<PartyHeader> packet(payload, 0);
+    if (!packet)
         return;
 
-    const auto partyHeader = reinterpret_cast<const PartyHeader *>(data);
-    data += sizeof(PartyHeader);
-    len -= sizeof(PartyHeader);
+    const auto playerCount = packet.get<PartyHeader::PlayerCount>();
+    qsizetype offset = packet.end();
 
-    for (uint32_t i = 0; i < partyHeader->partyPlayerCount; ++i)
+    for (uint32_t i = 0; i < playerCount; ++i)
     {
-        if (len < sizeof(PartyData))
+        const Record<PartyData> partyData(payload, offset);
+        if (!partyData)
             return;
 
-        const auto partyData = reinterpret_cast<const PartyData *>(data);
-        data += sizeof(PartyData);
-        len -= sizeof(PartyData);
+        const auto playerId = partyData.get<PartyData::PlayerId>();
+        const auto nickSize = partyData.get<PartyData::NickSize>();
+        offset = partyData.end();
 
-        if (len < partyData->nickSize)
+        if (!payload.contains(offset, nickSize))
             return;
 
-        const auto nick = QString::fromUtf16(partyData->nick, partyData->nickSize / sizeof(char16_t));
-        data += partyData->nickSize;
-        len -= partyData->nickSize;
+        const qsizetype nickOffset = offset;
+        offset += nickSize;
 
-        if (len < sizeof(uint8_t) * 2)
+        const Record<PartyDataTail> partyDataTail(payload, offset);
+        if (!partyDataTail)
             return;
 
-        const auto characterClass = reinterpret_cast<const uint8_t *>(data)[1];
+        offset += PartyDataTail::stride;
 
-        data += PartyDataUnknownSize;
-        len -= PartyDataUnknownSize;
+        // Longer nicks are truncated
+        auto &event = addEvent(DpsEvent::Type::PartyMember);
+        event.partyMember.id = playerId;
+        event.partyMember.characterClass = partyDataTail.get<PartyDataTail::CharacterClass>();
+        event.partyMember.nickLength = min<qsizetype>(nickSize / sizeof(char16_t), g_maxNickLength);
+        payload.read(event.partyMember.nick, nickOffset, event.partyMember.nickLength * sizeof(char16_t));
+    }
+}
+
+/**/
 
-        emit partyMember(partyData->playerId, nick, characterClass);
+SWPacketCapture::Payload::Payload(const uint8_t *data, qsizetype size, bool encrypted, qsizetype keyPosition)
+    : m_data(data)
+    , m_size(size)
+    , m_encrypted(encrypted)
+    , m_keyPosition(keyPosition)
+{
+}
+
+void SWPacketCapture::Payload::read(void *dst, qsizetype offset, qsizetype size) const
+{
+    if (!m_encrypted)
+    {
+        memcpy(dst, m_data + offset, size);
+        return;
     }
+
+    m_nDecryptedBytes += size;
+    XorDecrypt::decrypt(static_cast<uint8_t *>(dst), m_data + offset, size, m_keyPosition + offset);
 }
@@ -1,36 +1,216 @@
 #pragma once
 
+#include "DpsEvent.hpp"
+#include "FlowTable.hpp"
+#include "OpCodeProfiler.hpp"
+#include "SWPacketStructs.hpp"
+#include "XorDecrypt.hpp"
+
 #include <QObject>
 
+#include <atomic>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
 class SWPacketCapture : public QObject
 {
     Q_OBJECT
 
+public:
+    // All events decoded from one stream segment, in order
+    using EventConsumer = std::function<void(const DpsEvent *events, size_t count)>;
+
 public:
     SWPacketCapture(QObject *parent = nullptr);
     ~SWPacketCapture();
 
     bool init();
 
-    void newPacket(const uint8_t *data, qsizetype len);
+    void setEventConsumer(const EventConsumer &eventConsumer);
+
+    // Decrypt the opcode first and only the fields handlers read, unknown opcodes are decrypted only for samples
+    void setLazyDecrypt(bool lazyDecrypt);
+
+    void newPacket(uint32_t flowId, const uint8_t *data, qsizetype len, int64_t timestamp);
+    void resetFlow(uint32_t flowId);
+
+    inline uint64_t getNumBytes() const;
+    inline uint64_t getNumCopiedBytes() const;
+    inline uint64_t getNumPayloadBytes() const;
+    inline uint64_t getNumDecryptedBytes() const;
+
+    // Any thread
+    inline const OpCodeProfiler &getProfiler() const;
+
+private:
+    // Game packet body after the opcode, decrypted up front or on every read
+    class Payload
+    {
+    public:
+        // "keyPosition" is the position of "data" in the key stream
+        Payload(const uint8_t *data, qsizetype size, bool encrypted, qsizetype keyPosition);
+
+        inline qsizetype size() const;
+        inline bool contains(qsizetype offset, qsizetype size) const;
+
+        // Bounds are checked by the caller with "contains()" or through a "Record"
+        template <typename T>
+        inline T read(qsizetype offset) const;
+        void read(void *dst, qsizetype offset, qsizetype size) const;
+
+        inline qsizetype getNumDecryptedBytes() const;
+
+    private:
+        const uint8_t *const m_data;
+        const qsizetype m_size;
+        const bool m_encrypted;
+        const qsizetype m_keyPosition;
+        mutable qsizetype m_nDecryptedBytes = 0;
+    };
+
+    // Fixed-size record of layout "L" (see "SWPacketStructs.hpp") at an offset of the payload,
+    // invalid when it doesn't fit, so field loads of a valid record are always within bounds
+    template <typename L>
+    class Record
+    {
+    public:
+        inline Record(const Payload &payload, qsizetype offset);
+
+        inline explicit operator bool() const;
+        inline qsizetype end() const;
+
+        template <typename F>
+        inline typename F::Type get() const;
+
+    private:
+        const Payload &m_payload;
+        const qsizetype m_offset;
+        const bool m_valid;
+    };
+
+    using Handler = void (SWPacketCapture::*)(const Payload &payload);
 
 private:
-    void decrypt(uint8_t *data, qsizetype size);
-
-    void processWorldChangePacket(uint8_t *data, qsizetype len);
-    void processObjectCreatePacket(uint8_t *data, qsizetype len);
-    void processDamagePacket(uint8_t *data, qsizetype len);
-    void processAkasicPacket(uint8_t *data, qsizetype len);
-    void processPartyPacket(uint8_t *data, qsizetype len);
-    void processForcePacket(uint8_t *data, qsizetype len);
-
-signals:
-    void worldChange(uint32_t id, uint32_t worldId);
-    void ownerId(uint32_t id, uint32_t ownerId);
-    void damage(uint32_t srcId, uint16_t combo, uint32_t dstId, uint32_t dmg, uint32_t ssDmg, bool miss, bool crit);
-    void mazeEnd();
-    void partyMember(uint32_t id, const QString &nick, uint8_t characterClass);
+    static bool isValidHeader(const Packet::Header &header);
+
+    static Handler getHandler(OpCode op);
+
+    void processSegment(uint32_t flowId, const uint8_t *data, qsizetype len);
+    void processPacket(const uint8_t *packet, qsizetype len);
+
+    void processWorldChangePacket(const Payload &payload);
+    void processObjectCreatePacket(const Payload &payload);
+    void processDamagePacket(const Payload &payload);
+    void processAkasicPacket(const Payload &payload);
+    void processMazeEndPacket(const Payload &payload);
+    void processPartyPacket(const Payload &payload);
+
+    // Stamped with the packet which completed the game packet, delivered at the end of the segment
+    inline DpsEvent &addEvent(DpsEvent::Type type);
+    void flushEvents();
 
 private:
-    std::vector<uint8_t> m_data;
+    std::array<std::vector<uint8_t>, FlowTable::s_maxFlows> m_buffers; // Segmented packet per flow
+    std::unique_ptr<uint8_t[]> m_payload; // Decrypted payload of the current packet
+    int64_t m_timestamp = 0; // Of the current packet
+    bool m_lazyDecrypt = false;
+
+    std::vector<DpsEvent> m_events; // Of the current segment
+    EventConsumer m_eventConsumer;
+
+    OpCodeProfiler m_profiler;
+
+    std::atomic<uint64_t> m_nBytes {0};
+    std::atomic<uint64_t> m_nCopiedBytes {0};
+    std::atomic<uint64_t> m_nPayloadBytes {0};
+    std::atomic<uint64_t> m_nDecryptedBytes {0};
 };
+
+inline uint64_t SWPacketCapture::getNumBytes() const
+{
+    return m_nBytes.load(std::memory_order_relaxed);
+}
+inline uint64_t SWPacketCapture::getNumCopiedBytes() const
+{
+    return m_nCopiedBytes.load(std::memory_order_relaxed);
+}
+inline uint64_t SWPacketCapture::getNumPayloadBytes() const
+{
+    return m_nPayloadBytes.load(std::memory_order_relaxed);
+}
+inline uint64_t SWPacketCapture::getNumDecryptedBytes() const
+{
+    return m_nDecryptedBytes.load(std::memory_order_relaxed);
+}
+
+inline const OpCodeProfiler &SWPacketCapture::getProfiler() const
+{
+    return m_profiler;
+}
+
+inline DpsEvent &SWPacketCapture::addEvent(DpsEvent::Type type)
+{
+    auto &event = m_events.emplace_back();
+    event.type = type;
+    event.timestamp = m_timestamp;
+    return event;
+}
+
+inline qsizetype SWPacketCapture::Payload::size() const
+{
+    return m_size;
+}
+
+inline bool SWPacketCapture::Payload::contains(qsizetype offset, qsizetype size) const
+{
+    return (offset >= 0 && size >= 0 && offset <= m_size && size <= m_size - offset);
+}
+
+template <typename T>
+inline T SWPacketCapture::Payload::read(qsizetype offset) const
+{
+    if (!m_encrypted)
+    {
+        T value;
+        memcpy(&value, m_data + offset, sizeof(T));
+        return value;
+    }
+
+    m_nDecryptedBytes += sizeof(T);
+    return XorDecrypt::decryptValue<T>(m_data + offset, m_keyPosition + offset);
+}
+
+inline qsizetype SWPacketCapture::Payload::getNumDecryptedBytes() const
+{
+    return m_nDecryptedBytes;
+}
+
+template <typename L>
+inline SWPacketCapture::Record<L>::Record(const Payload &payload, qsizetype offset)
+    : m_payload(payload)
+    , m_offset(offset)
+    , m_valid(payload.contains(offset, L::size))
+{
+}
+
+template <typename L>
+inline SWPacketCapture::Record<L>::operator bool() const
+{
+    return m_valid;
+}
+template <typename L>
+inline qsizetype SWPacketCapture::Record<L>::end() const
+{
+    return m_offset + L::size;
+}
+
+template <typename L>
+template <typename F>
+inline typename F::Type SWPacketCapture::Record<L>::get() const
+{
+    static_assert(std::is_base_of_v<typename F::Layout, L>, "Field of another layout");
+    static_assert(F::offset >= 0 && F::offset + static_cast<qsizetype>(sizeof(typename F::Type)) <= L::size, "Field outside of its layout");
+    Q_ASSERT(m_valid);
+    return m_payload.read<typename F::Type>(m_offset + F::offset);
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <QtGlobal>
+
 #include <cstdint>
 
 enum class OpCode : uint16_t
@@ -24,65 +26,104 @@ struct Header
     uint8_t type;
 };
 
-struct WorldChange
+#pragma pack()
+
+// Layout descriptors: fixed size of a message or record and the offsets of the fields the meter reads.
+// Fields are loaded with memcpy (unaligned-safe) from records whose size was checked once,
+// "Field" verifies at compile time that it lies within its layout.
+
+template <qsizetype Size>
+struct Layout
 {
-    uint32_t id;
-    uint8_t unknown1[20];
-    uint16_t worldId;
-    uint8_t unknown2[63];
+    static constexpr qsizetype size = Size;
 };
 
-struct PartyHeader
+template <typename L, typename T, qsizetype Offset>
+struct Field
 {
-    uint8_t unknown01[4];
-    uint32_t partyHostId;
-    uint8_t unknown02[10];
-    uint8_t partyPlayerCount;
+    using Layout = L;
+    using Type = T;
+    static constexpr qsizetype offset = Offset;
 };
-struct PartyData
+
+// Messages, the payload after the opcode
+
+struct WorldChange : Layout<89>
 {
-    uint32_t playerId;
-    uint16_t nickSize;
-    char16_t nick[];
+    static constexpr auto opCode = OpCode::WorldChange;
+    using Id = Field<WorldChange, uint32_t, 0>;
+    using WorldId = Field<WorldChange, uint16_t, 24>;
 };
-constexpr auto PartyDataUnknownSize = 32;
 
-struct DamageMonster
+struct ObjectCreate : Layout<100>
 {
-    uint32_t monsterId;
-    uint8_t unknown01;
-    uint8_t damageType;
-    uint32_t totalDmg;
-    uint32_t soulstoneDmg;
-    uint32_t remainHp;
-    uint8_t unknown02[22];
+    static constexpr auto opCode = OpCode::ObjectCreate;
+    using Id = Field<ObjectCreate, uint32_t, 1>;
+    using OwnerId = Field<ObjectCreate, uint32_t, 38>;
 };
-struct DamagePlayer
+
+// Followed by "MonsterCount" x "DamageMonster" and one "DamagePlayer"
+struct Damage : Layout<1>
 {
-    uint32_t playerId;
-    uint8_t unknown01[20];
-    uint32_t skillId;
-    uint8_t unknown02[2];
-    uint16_t maxCombo;
-    uint8_t unknown03[2];
+    static constexpr auto opCode = OpCode::Damage;
+    using MonsterCount = Field<Damage, uint8_t, 0>;
 };
 
-struct ObjectCreate
+struct Akasic : Layout<8>
 {
-    uint8_t unknown01;
-    uint32_t id;
-    uint8_t unknown02[33];
-    uint32_t owner_id;
-    uint8_t unknown03[54];
-    uint32_t db2;
+    static constexpr auto opCode = OpCode::Akasic;
+    using OwnerId = Field<Akasic, uint32_t, 0>;
+    using Id = Field<Akasic, uint32_t, 4>;
 };
 
-struct Akasic
+struct MazeEnd : Layout<0>
 {
-    uint32_t owner_id;
-    uint32_t id;
+    static constexpr auto opCode = OpCode::MazeEnd;
 };
 
-#pragma pack()
+// Followed by "PlayerCount" x ("PartyData", nick, "PartyDataTail")
+struct PartyHeader : Layout<19>
+{
+    using PartyHostId = Field<PartyHeader, uint32_t, 4>;
+    using PlayerCount = Field<PartyHeader, uint8_t, 18>;
+};
+struct Party : PartyHeader
+{
+    static constexpr auto opCode = OpCode::Party;
+};
+struct Force : PartyHeader
+{
+    static constexpr auto opCode = OpCode::Force;
+};
+
+// Records inside messages
+
+struct DamageMonster : Layout<40>
+{
+    using MonsterId = Field<DamageMonster, uint32_t, 0>;
+    using DamageType = Field<DamageMonster, uint8_t, 5>;
+    using TotalDmg = Field<DamageMonster, uint32_t, 6>;
+    using SoulstoneDmg = Field<DamageMonster, uint32_t, 10>;
+    using RemainHp = Field<DamageMonster, uint32_t, 14>;
+};
+struct DamagePlayer : Layout<34>
+{
+    using PlayerId = Field<DamagePlayer, uint32_t, 0>;
+    using SkillId = Field<DamagePlayer, uint32_t, 24>;
+    using MaxCombo = Field<DamagePlayer, uint16_t, 30>;
+};
+
+// Followed by "NickSize" bytes of UTF-16 nick
+struct PartyData : Layout<6>
+{
+    using PlayerId = Field<PartyData, uint32_t, 0>;
+    using NickSize = Field<PartyData, uint16_t, 4>;
+};
+// Only the class is read, but the next player starts after "stride" bytes
+struct PartyDataTail : Layout<2>
+{
+    static constexpr qsizetype stride = 32;
+    using CharacterClass = Field<PartyDataTail, uint8_t, 1>;
+};
 
 }
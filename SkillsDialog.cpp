@@ -0,0 +1,44 @@
+#include "SkillsDialog.hpp"
+#include "DpsLogic.hpp"
+
+#include <QFontDatabase>
+#include <QPlainTextEdit>
+#include <QTextStream>
+#include <QTimer>
+#include <QVBoxLayout>
+
+SkillsDialog::SkillsDialog(const DpsLogic &dpsLogic, uint32_t playerId, const QString &playerName, QWidget *parent)
+    : QDialog(parent)
+    , m_dpsLogic(dpsLogic)
+    , m_playerId(playerId)
+    , m_text(new QPlainTextEdit)
+{
+    setWindowTitle(tr("Skills - %1").arg(playerName));
+    resize(600, 400);
+
+    m_text->setReadOnly(true);
+    m_text->setLineWrapMode(QPlainTextEdit::NoWrap);
+    m_text->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    auto layout = new QVBoxLayout(this);
+    layout->addWidget(m_text);
+
+    auto timer = new QTimer(this);
+    connect(timer, &QTimer::timeout,
+            this, &SkillsDialog::refresh);
+    timer->start(1000);
+
+    refresh();
+}
+SkillsDialog::~SkillsDialog()
+{
+}
+
+void SkillsDialog::refresh()
+{
+    QString report;
+    QTextStream stream(&report);
+    m_dpsLogic.writeSkills(m_playerId, stream);
+    stream.flush();
+    m_text->setPlainText(report);
+}
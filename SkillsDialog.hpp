@@ -0,0 +1,25 @@
+#pragma once
+
+#include <QDialog>
+
+class QPlainTextEdit;
+class DpsLogic;
+
+// Damage of one player by skill in the current encounter, refreshed every second
+class SkillsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    SkillsDialog(const DpsLogic &dpsLogic, uint32_t playerId, const QString &playerName, QWidget *parent = nullptr);
+    ~SkillsDialog();
+
+private:
+    void refresh();
+
+private:
+    const DpsLogic &m_dpsLogic;
+    const uint32_t m_playerId;
+
+    QPlainTextEdit *const m_text;
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// Bounded lock-free ring for exactly one producer thread and one consumer thread
+template <typename T>
+class SpscRing
+{
+public:
+    explicit SpscRing(size_t capacity);
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    inline size_t capacity() const;
+    inline size_t size() const; // Approximate when called concurrently
+
+    // Producer
+    inline bool push(const T &value);
+    template <typename Fn>
+    inline bool produce(Fn &&fn); // Fills the slot in place, so elements owning memory keep it
+
+    // Consumer
+    inline bool pop(T &value);
+    template <typename Fn>
+    inline size_t consume(Fn &&fn);
+
+private:
+    static constexpr size_t s_cacheLineSize = 64;
+
+    const size_t m_mask;
+    const std::unique_ptr<T[]> m_data;
+
+    alignas(s_cacheLineSize) std::atomic<size_t> m_head {0}; // Next write position
+    size_t m_cachedTail = 0; // Producer's copy of "m_tail"
+
+    alignas(s_cacheLineSize) std::atomic<size_t> m_tail {0}; // Next read position
+    size_t m_cachedHead = 0; // Consumer's copy of "m_head"
+};
+
+template <typename T>
+SpscRing<T>::SpscRing(size_t capacity)
+    : m_mask([](size_t capacity) {
+        size_t powerOfTwo = 1;
+        while (powerOfTwo < capacity)
+            powerOfTwo <<= 1;
+        return powerOfTwo - 1;
+    }(capacity))
+    , m_data(std::make_unique<T[]>(m_mask + 1))
+{
+}
+
+template <typename T>
+inline size_t SpscRing<T>::capacity() const
+{
+    return m_mask + 1;
+}
+template <typename T>
+inline size_t SpscRing<T>::size() const
+{
+    const size_t tail = m_tail.load(std::memory_order_acquire);
+    const size_t head = m_head.load(std::memory_order_acquire);
+    return head - tail;
+}
+
+template <typename T>
+inline bool SpscRing<T>::push(const T &value)
+{
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    if (head - m_cachedTail > m_mask)
+    {
+        m_cachedTail = m_tail.load(std::memory_order_acquire);
+        if (head - m_cachedTail > m_mask)
+            return false;
+    }
+
+    m_data[head & m_mask] = value;
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+template <typename Fn>
+inline bool SpscRing<T>::produce(Fn &&fn)
+{
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    if (head - m_cachedTail > m_mask)
+    {
+        m_cachedTail = m_tail.load(std::memory_order_acquire);
+        if (head - m_cachedTail > m_mask)
+            return false;
+    }
+
+    fn(m_data[head & m_mask]);
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+inline bool SpscRing<T>::pop(T &value)
+{
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail == m_cachedHead)
+    {
+        m_cachedHead = m_head.load(std::memory_order_acquire);
+        if (tail == m_cachedHead)
+            return false;
+    }
+
+    value = m_data[tail & m_mask];
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+template <typename Fn>
+inline size_t SpscRing<T>::consume(Fn &&fn)
+{
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    m_cachedHead = m_head.load(std::memory_order_acquire);
+
+    for (size_t i = tail; i != m_cachedHead; ++i)
+        fn(m_data[i & m_mask]);
+
+    m_tail.store(m_cachedHead, std::memory_order_release);
+    return m_cachedHead - tail;
+}
@@ -0,0 +1,216 @@
+#include "TPacketV3.hpp"
+
+#include <QDebug>
+
+#include <linux/if_packet.h>
+#include <linux/filter.h>
+#include <net/ethernet.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <pcap/pcap.h>
+
+#include <atomic>
+
+using namespace std;
+
+constexpr uint32_t g_blockSize = 1 << 20;
+constexpr uint32_t g_defaultNumBlocks = 16;
+constexpr uint32_t g_minNumBlocks = 2;
+constexpr uint32_t g_frameSize = 2048; // Frames are variable-sized in V3, used only for the ring geometry
+constexpr uint32_t g_blockTimeout = 10; // ms, hand out partially filled blocks
+constexpr uint32_t g_immediateBlockTimeout = 1; // ms, shortest timeout the kernel supports
+
+TPacketV3::TPacketV3(const Options &options)
+    : m_nBlocks((options.bufferSize > 0) ? max<uint32_t>(options.bufferSize / g_blockSize, g_minNumBlocks) : g_defaultNumBlocks)
+    , m_blockTimeout(options.immediateMode ? g_immediateBlockTimeout : g_blockTimeout)
+    , m_snapLen(options.snapLen)
+    , m_socketNotifier(QSocketNotifier::Read, this)
+{
+    connect(&m_socketNotifier, &QSocketNotifier::activated,
+            this, &TPacketV3::activated);
+}
+TPacketV3::~TPacketV3()
+{
+    closeSocket();
+}
+
+bool TPacketV3::init(uint16_t port)
+{
+    closeSocket();
+
+    // SOCK_DGRAM strips the link-layer header, frames start at the IP header
+    m_fd = socket(AF_PACKET, SOCK_DGRAM, htons(ETH_P_IP));
+    if (m_fd < 0)
+    {
+        qCritical() << "Can't open packet socket:" << strerror(errno);
+        return false;
+    }
+
+    const int version = TPACKET_V3;
+    if (setsockopt(m_fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
+    {
+        qCritical() << "TPACKET_V3 not supported:" << strerror(errno);
+        closeSocket();
+        return false;
+    }
+
+    // Set filter before the ring, so the ring is never filled with unrelated packets
+    m_port = port;
+    if (!setFilter(makeFilter()))
+    {
+        closeSocket();
+        return false;
+    }
+
+    tpacket_req3 req = {};
+    req.tp_block_size = g_blockSize;
+    req.tp_block_nr = m_nBlocks;
+    req.tp_frame_size = g_frameSize;
+    req.tp_frame_nr = getRingSize() / g_frameSize;
+    req.tp_retire_blk_tov = m_blockTimeout;
+    if (setsockopt(m_fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0)
+    {
+        qCritical() << "Can't create packet ring:" << strerror(errno);
+        closeSocket();
+        return false;
+    }
+
+    void *ring = mmap(nullptr, getRingSize(), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, 0);
+    if (ring == MAP_FAILED)
+    {
+        qCritical() << "Can't map packet ring:" << strerror(errno);
+        closeSocket();
+        return false;
+    }
+    m_ring = static_cast<uint8_t *>(ring);
+    m_blockIdx = 0;
+
+    m_socketNotifier.setSocket(m_fd);
+    m_socketNotifier.setEnabled(true);
+
+    return true;
+}
+
+uint64_t TPacketV3::readNumDrops()
+{
+    if (m_fd < 0)
+        return m_nDrops;
+
+    // Kernel resets the counters on every read
+    tpacket_stats_v3 stats = {};
+    socklen_t len = sizeof(stats);
+    if (getsockopt(m_fd, SOL_PACKET, PACKET_STATISTICS, &stats, &len) == 0)
+        m_nDrops += stats.tp_drops;
+    return m_nDrops;
+}
+
+bool TPacketV3::setFilter(const QByteArray &filterStr)
+{
+    // The filter returns the snap length for accepted packets, the kernel copies only that much into the ring
+    const auto handle = pcap_open_dead(DLT_RAW, m_snapLen);
+    if (!handle)
+        return false;
+
+    bpf_program fp = {};
+    if (pcap_compile(handle, &fp, filterStr, true, PCAP_NETMASK_UNKNOWN) == -1)
+    {
+        qCritical() << pcap_geterr(handle);
+        pcap_close(handle);
+        return false;
+    }
+    pcap_close(handle);
+
+    sock_fprog prog = {};
+    prog.len = fp.bf_len;
+    prog.filter = reinterpret_cast<sock_filter *>(fp.bf_insns);
+
+    const bool ok = (setsockopt(m_fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) == 0);
+    if (!ok)
+        qCritical() << "Can't attach filter:" << strerror(errno);
+
+    pcap_freecode(&fp);
+    return ok;
+}
+
+void TPacketV3::updateFilter()
+{
+    // SO_ATTACH_FILTER replaces the previous filter atomically
+    if (m_fd >= 0)
+        setFilter(makeFilter());
+}
+
+size_t TPacketV3::getRingSize() const
+{
+    return static_cast<size_t>(g_blockSize) * m_nBlocks;
+}
+
+void TPacketV3::closeSocket()
+{
+    m_socketNotifier.setEnabled(false);
+
+    if (m_ring)
+    {
+        munmap(m_ring, getRingSize());
+        m_ring = nullptr;
+    }
+
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+void TPacketV3::activated()
+{
+    for (;;)
+    {
+        const auto block = reinterpret_cast<tpacket_block_desc *>(m_ring + static_cast<size_t>(m_blockIdx) * g_blockSize);
+
+        auto &blockStatus = block->hdr.bh1.block_status;
+        if (!(__atomic_load_n(&blockStatus, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+            break;
+
+        processBlock(block);
+
+        // Give the block back to the kernel
+        __atomic_store_n(&blockStatus, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+
+        m_blockIdx = (m_blockIdx + 1) % m_nBlocks;
+    }
+
+    flushFlowChanges();
+}
+
+void TPacketV3::processBlock(const tpacket_block_desc *block)
+{
+    const auto blockData = reinterpret_cast<const uint8_t *>(block);
+    const auto nPackets = block->hdr.bh1.num_pkts;
+
+    auto frame = blockData + block->hdr.bh1.offset_to_first_pkt;
+    for (uint32_t i = 0; i < nPackets; ++i)
+    {
+        const auto header = reinterpret_cast<const tpacket3_hdr *>(frame);
+        const auto addr = reinterpret_cast<const sockaddr_ll *>(frame + TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+
+        if (addr->sll_pkttype != PACKET_HOST)
+        {
+            // Not unicast to us
+        }
+        else if (header->tp_snaplen < header->tp_len)
+        {
+            // Truncated to the snapshot length, dropped like in "PCap", the reassembly takes it as lost data
+            qCritical() << "Packet larger than the snapshot length";
+        }
+        else
+        {
+            const int64_t timestamp = header->tp_sec * 1'000'000'000ll + header->tp_nsec;
+            processPacket(frame + header->tp_net, header->tp_snaplen, timestamp);
+        }
+
+        frame += header->tp_next_offset;
+    }
+}
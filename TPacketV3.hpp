@@ -0,0 +1,44 @@
+#pragma once
+
+#include "PacketCapture.hpp"
+
+#include <QSocketNotifier>
+
+struct tpacket_block_desc;
+
+class TPacketV3 : public PacketCapture
+{
+    Q_OBJECT
+
+public:
+    TPacketV3(const Options &options = {});
+    ~TPacketV3();
+
+    bool init(uint16_t port) override;
+
+protected:
+    void updateFilter() override;
+    uint64_t readNumDrops() override;
+
+private:
+    bool setFilter(const QByteArray &filterStr);
+
+    size_t getRingSize() const;
+
+    void closeSocket();
+
+    void activated();
+
+    void processBlock(const tpacket_block_desc *block);
+
+private:
+    const uint32_t m_nBlocks;
+    const uint32_t m_blockTimeout;
+    const uint32_t m_snapLen;
+
+    int m_fd = -1;
+    uint8_t *m_ring = nullptr;
+    uint32_t m_blockIdx = 0;
+    uint64_t m_nDrops = 0;
+    QSocketNotifier m_socketNotifier;
+};
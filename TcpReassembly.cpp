@@ -0,0 +1,95 @@
+#include "TcpReassembly.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+TcpReassembly::TcpReassembly()
+{
+}
+TcpReassembly::~TcpReassembly()
+{
+}
+
+void TcpReassembly::reset(uint32_t seq)
+{
+    m_seq = seq;
+    m_ringStart = 0;
+    m_intervals.clear();
+}
+
+void TcpReassembly::release()
+{
+    reset(0);
+    m_ring.reset();
+    m_intervals.shrink_to_fit();
+}
+
+void TcpReassembly::store(uint32_t offset, const uint8_t *data, uint32_t len, int64_t time)
+{
+    if (!m_ring)
+        m_ring = make_unique<uint8_t[]>(s_maxBuffered);
+
+    if (m_intervals.empty())
+        m_gapTime = time;
+
+    const uint32_t pos = (m_ringStart + offset) & s_ringMask;
+    const uint32_t firstLen = min(len, s_maxBuffered - pos);
+    memcpy(m_ring.get() + pos, data, firstLen);
+    if (firstLen < len)
+        memcpy(m_ring.get(), data + firstLen, len - firstLen);
+
+    Interval newInterval {offset, offset + len};
+
+    // First interval which can touch the new one
+    auto it = lower_bound(m_intervals.begin(), m_intervals.end(), newInterval.begin, [](const Interval &interval, uint32_t begin) {
+        return (interval.end < begin);
+    });
+
+    // Merge all touching intervals into the new one
+    uint32_t duplicateBytes = 0;
+    auto last = it;
+    for (; last != m_intervals.end() && last->begin <= newInterval.end; ++last)
+    {
+        const uint32_t overlapBegin = max(last->begin, offset);
+        const uint32_t overlapEnd = min(last->end, offset + len);
+        if (overlapEnd > overlapBegin)
+            duplicateBytes += overlapEnd - overlapBegin;
+
+        newInterval.begin = min(newInterval.begin, last->begin);
+        newInterval.end = max(newInterval.end, last->end);
+    }
+
+    m_stats.duplicateBytes += duplicateBytes;
+    m_stats.bufferedBytes += len - duplicateBytes;
+
+    if (it == last)
+    {
+        m_intervals.insert(it, newInterval);
+    }
+    else
+    {
+        *it = newInterval;
+        m_intervals.erase(it + 1, last);
+    }
+}
+
+void TcpReassembly::advance(uint32_t len)
+{
+    m_seq += len;
+    m_ringStart = (m_ringStart + len) & s_ringMask;
+
+    size_t nRemoved = 0;
+    for (auto &&interval : m_intervals)
+    {
+        if (interval.end <= len)
+        {
+            ++nRemoved;
+            continue;
+        }
+        interval.begin = (interval.begin > len) ? interval.begin - len : 0;
+        interval.end -= len;
+    }
+    m_intervals.erase(m_intervals.begin(), m_intervals.begin() + nRemoved);
+}
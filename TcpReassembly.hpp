@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// In-order delivery of one TCP byte stream. Sequence numbers use 32-bit serial number
+// arithmetic, out-of-order data is kept in a fixed size ring, in-order data is never copied.
+class TcpReassembly
+{
+public:
+    static constexpr uint32_t s_maxBuffered = 256 * 1024;
+    static constexpr int64_t s_gapTimeout = 1'000; // ms
+
+    struct Stats
+    {
+        uint64_t inOrderBytes = 0;
+        uint64_t bufferedBytes = 0;
+        uint64_t duplicateBytes = 0;
+        uint64_t lostBytes = 0;
+        uint64_t gaps = 0;
+    };
+
+public:
+    TcpReassembly();
+    ~TcpReassembly();
+
+    void reset(uint32_t seq);
+    void release();
+
+    inline uint32_t getBufferedBytes() const;
+    inline const Stats &getStats() const;
+
+    // "dataFn(const uint8_t *data, uint32_t len)" receives the stream in order,
+    // "gapFn(uint32_t lostBytes)" is called when missing data is given up
+    template <typename DataFn, typename GapFn>
+    inline void push(uint32_t seq, const uint8_t *data, uint32_t len, int64_t time, DataFn &&dataFn, GapFn &&gapFn);
+
+private:
+    struct Interval
+    {
+        uint32_t begin; // Relative to "m_seq"
+        uint32_t end;
+    };
+
+    void store(uint32_t offset, const uint8_t *data, uint32_t len, int64_t time);
+    void advance(uint32_t len);
+
+    template <typename DataFn>
+    inline void deliverBuffered(DataFn &&dataFn);
+    template <typename DataFn, typename GapFn>
+    inline void skipGap(int64_t time, DataFn &&dataFn, GapFn &&gapFn);
+
+private:
+    static constexpr uint32_t s_ringMask = s_maxBuffered - 1;
+    static_assert((s_maxBuffered & s_ringMask) == 0);
+
+    uint32_t m_seq = 0; // Next expected sequence number
+
+    std::unique_ptr<uint8_t[]> m_ring; // Allocated on first out-of-order segment
+    uint32_t m_ringStart = 0; // Ring position of "m_seq"
+    std::vector<Interval> m_intervals; // Sorted, not overlapping, not adjacent
+    int64_t m_gapTime = 0;
+
+    Stats m_stats;
+};
+
+inline uint32_t TcpReassembly::getBufferedBytes() const
+{
+    uint32_t bufferedBytes = 0;
+    for (auto &&interval : m_intervals)
+        bufferedBytes += interval.end - interval.begin;
+    return bufferedBytes;
+}
+inline const TcpReassembly::Stats &TcpReassembly::getStats() const
+{
+    return m_stats;
+}
+
+template <typename DataFn, typename GapFn>
+inline void TcpReassembly::push(uint32_t seq, const uint8_t *data, uint32_t len, int64_t time, DataFn &&dataFn, GapFn &&gapFn)
+{
+    if (len == 0)
+        return;
+
+    if (!m_intervals.empty() && time - m_gapTime > s_gapTimeout)
+        skipGap(time, dataFn, gapFn);
+
+    uint32_t offset = seq - m_seq;
+    if (static_cast<int32_t>(offset) < 0)
+    {
+        // Starts before the expected sequence number, retransmission
+        const uint32_t old = m_seq - seq;
+        if (old >= len)
+        {
+            m_stats.duplicateBytes += len;
+            return;
+        }
+        m_stats.duplicateBytes += old;
+        data += old;
+        len -= old;
+        offset = 0;
+    }
+
+    if (offset > 0 && static_cast<uint64_t>(offset) + len > s_maxBuffered)
+    {
+        // Too far ahead, the missing data is not going to arrive anymore
+        while (!m_intervals.empty())
+            skipGap(time, dataFn, gapFn);
+
+        offset = seq - m_seq;
+        if (static_cast<int32_t>(offset) > 0)
+        {
+            gapFn(offset);
+            m_stats.lostBytes += offset;
+            m_stats.gaps += 1;
+            m_seq = seq;
+        }
+        else if (offset != 0)
+        {
+            // The buffered data delivered above covers the head of this segment
+            const uint32_t old = m_seq - seq;
+            if (old >= len)
+            {
+                m_stats.duplicateBytes += len;
+                return;
+            }
+            m_stats.duplicateBytes += old;
+            data += old;
+            len -= old;
+        }
+        offset = 0;
+    }
+
+    if (offset > 0)
+    {
+        store(offset, data, len, time);
+        return;
+    }
+
+    m_stats.inOrderBytes += len;
+    dataFn(data, len);
+    advance(len);
+    deliverBuffered(dataFn);
+}
+
+template <typename DataFn>
+inline void TcpReassembly::deliverBuffered(DataFn &&dataFn)
+{
+    while (!m_intervals.empty() && m_intervals.front().begin == 0)
+    {
+        const uint32_t len = m_intervals.front().end;
+
+        const uint32_t firstLen = std::min(len, s_maxBuffered - m_ringStart);
+        dataFn(m_ring.get() + m_ringStart, firstLen);
+        if (firstLen < len)
+            dataFn(m_ring.get(), len - firstLen);
+
+        advance(len);
+    }
+}
+
+template <typename DataFn, typename GapFn>
+inline void TcpReassembly::skipGap(int64_t time, DataFn &&dataFn, GapFn &&gapFn)
+{
+    const uint32_t lostBytes = m_intervals.front().begin;
+    gapFn(lostBytes);
+    m_stats.lostBytes += lostBytes;
+    m_stats.gaps += 1;
+
+    advance(lostBytes);
+    deliverBuffered(dataFn);
+
+    m_gapTime = time;
+}
@@ -1,11 +1,14 @@
 #include "WinDivert.hpp"
 
+#include <QDateTime>
 #include <QThread>
 
 using namespace std;
 
 WinDivert::WinDivert()
 {
+    // The filter is fixed when the handle is opened
+    setDynamicFilter(false);
 }
 WinDivert::~WinDivert()
 {
@@ -27,6 +30,7 @@ WinDivert::~WinDivert()
 
 bool WinDivert::init(uint16_t port)
 {
+    m_port = port;
     m_handle = WinDivertOpen(
         QString("tcp.SrcPort == %1").arg(port).toLatin1().constData(),
         WINDIVERT_LAYER_NETWORK,
@@ -36,12 +40,28 @@ bool WinDivert::init(uint16_t port)
     if (m_handle == INVALID_HANDLE_VALUE)
         return false;
 
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    m_counterFrequency = frequency.QuadPart;
+    m_counterBase = counter.QuadPart;
+    m_timestampBase = QDateTime::currentMSecsSinceEpoch() * 1'000'000ll;
+
     m_thread = QThread::create(bind(&WinDivert::receivePacketThread, this));
     m_thread->start();
 
     return true;
 }
 
+int64_t WinDivert::getTimestamp(int64_t performanceCounter) const
+{
+    // Split to seconds first, nanoseconds of a whole counter would overflow in minutes
+    const int64_t ticks = performanceCounter - m_counterBase;
+    const int64_t seconds = ticks / m_counterFrequency;
+    const int64_t remainder = ticks % m_counterFrequency;
+    return m_timestampBase + seconds * 1'000'000'000ll + remainder * 1'000'000'000ll / m_counterFrequency;
+}
+
 void WinDivert::receivePacketThread()
 {
     auto packet = make_unique<uint8_t[]>(WINDIVERT_MTU_MAX);
@@ -62,7 +82,7 @@ void WinDivert::receivePacketThread()
         );
         if (ok)
         {
-            processPacket(packet.get(), recvLen);
+            processPacket(packet.get(), recvLen, getTimestamp(addr.Timestamp));
         }
     }
 }
@@ -17,9 +17,16 @@ public:
     bool init(uint16_t port) override;
 
 private:
+    int64_t getTimestamp(int64_t performanceCounter) const;
+
     void receivePacketThread();
 
 private:
+    // Maps QueryPerformanceCounter() packet timestamps to the system clock
+    int64_t m_counterFrequency = 1;
+    int64_t m_counterBase = 0;
+    int64_t m_timestampBase = 0;
+
     HANDLE m_handle = INVALID_HANDLE_VALUE;
     QThread *m_thread = nullptr;
 };
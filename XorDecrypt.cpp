@@ -0,0 +1,196 @@
+#include "XorDecrypt.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#ifdef XOR_DECRYPT_X86
+#   include <immintrin.h>
+#   ifdef _MSC_VER
+#       include <intrin.h>
+#   endif
+#endif
+
+#if defined(XOR_DECRYPT_X86) && !defined(_MSC_VER)
+#   define XOR_DECRYPT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#   define XOR_DECRYPT_TARGET_AVX2
+#endif
+
+namespace XorDecrypt {
+
+constexpr size_t g_keySize = 3;
+
+// Key repeated to a multiple of 3 and of the vector sizes (16 * 3 and 32 * 3)
+constexpr size_t g_patternSize = 96;
+alignas(32) constexpr auto g_pattern = [] {
+    std::array<uint8_t, g_patternSize> pattern = {};
+    for (size_t i = 0; i < g_patternSize; ++i)
+        pattern[i] = g_keyStream[i % g_keySize];
+    return pattern;
+}();
+
+// Tail shorter than a whole pattern, "offset" must be a multiple of the pattern period
+static inline void decryptTail(uint8_t *dst, const uint8_t *src, size_t offset, size_t size)
+{
+    size_t i = offset;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t data, key;
+        memcpy(&data, src + i, sizeof(data));
+        memcpy(&key, g_pattern.data() + (i - offset), sizeof(key));
+        data ^= key;
+        memcpy(dst + i, &data, sizeof(data));
+    }
+    for (; i < size; ++i)
+        dst[i] = src[i] ^ g_pattern[i - offset];
+}
+
+void decryptReference(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+        dst[i] = src[i] ^ g_keyStream[i % g_keySize];
+}
+
+void decryptScalar(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    size_t i = 0;
+    for (; i + g_patternSize <= size; i += g_patternSize)
+    {
+        for (size_t j = 0; j < g_patternSize; ++j)
+            dst[i + j] = src[i + j] ^ g_pattern[j];
+    }
+    decryptTail(dst, src, i, size);
+}
+
+#ifdef XOR_DECRYPT_X86
+
+// Less than 48 bytes from "offset", inlined so the AVX2 path gets VEX encoding (no SSE transition penalty)
+static inline void decryptSse2Tail(uint8_t *dst, const uint8_t *src, size_t offset, size_t size)
+{
+    const auto key = reinterpret_cast<const __m128i *>(g_pattern.data());
+
+    size_t i = offset;
+    for (int k = 0; k < 2 && i + 16 <= size; ++k, i += 16)
+    {
+        const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_xor_si128(data, _mm_load_si128(key + k)));
+    }
+    for (; i < size; ++i)
+        dst[i] = src[i] ^ g_pattern[i - offset];
+}
+
+void decryptSse2(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    const auto key = reinterpret_cast<const __m128i *>(g_pattern.data());
+    const __m128i k0 = _mm_load_si128(key + 0);
+    const __m128i k1 = _mm_load_si128(key + 1);
+    const __m128i k2 = _mm_load_si128(key + 2);
+
+    size_t i = 0;
+    for (; i + 48 <= size; i += 48)
+    {
+        const auto s = reinterpret_cast<const __m128i *>(src + i);
+        const auto d = reinterpret_cast<__m128i *>(dst + i);
+        _mm_storeu_si128(d + 0, _mm_xor_si128(_mm_loadu_si128(s + 0), k0));
+        _mm_storeu_si128(d + 1, _mm_xor_si128(_mm_loadu_si128(s + 1), k1));
+        _mm_storeu_si128(d + 2, _mm_xor_si128(_mm_loadu_si128(s + 2), k2));
+    }
+    decryptSse2Tail(dst, src, i, size);
+}
+
+XOR_DECRYPT_TARGET_AVX2 void decryptAvx2(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    const auto key = reinterpret_cast<const __m256i *>(g_pattern.data());
+    const __m256i k0 = _mm256_load_si256(key + 0);
+    const __m256i k1 = _mm256_load_si256(key + 1);
+    const __m256i k2 = _mm256_load_si256(key + 2);
+
+    size_t i = 0;
+    for (; i + 96 <= size; i += 96)
+    {
+        const auto s = reinterpret_cast<const __m256i *>(src + i);
+        const auto d = reinterpret_cast<__m256i *>(dst + i);
+        _mm256_storeu_si256(d + 0, _mm256_xor_si256(_mm256_loadu_si256(s + 0), k0));
+        _mm256_storeu_si256(d + 1, _mm256_xor_si256(_mm256_loadu_si256(s + 1), k1));
+        _mm256_storeu_si256(d + 2, _mm256_xor_si256(_mm256_loadu_si256(s + 2), k2));
+    }
+
+    // Most game packets are short, finish with 16 byte vectors
+    if (i + 48 <= size)
+    {
+        const auto s = reinterpret_cast<const __m256i *>(src + i);
+        const auto d = reinterpret_cast<__m256i *>(dst + i);
+        _mm256_storeu_si256(d, _mm256_xor_si256(_mm256_loadu_si256(s), k0));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 32), _mm_xor_si128(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 32)),
+            _mm256_castsi256_si128(k1)
+        ));
+        i += 48;
+    }
+    decryptSse2Tail(dst, src, i, size);
+}
+
+bool hasAvx2()
+{
+#   ifdef _MSC_VER
+    int info[4] = {};
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    // The OS has to save the YMM registers
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27));
+    if (!osxsave || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5));
+#   else
+    __builtin_cpu_init(); // May run from static initialization
+    return __builtin_cpu_supports("avx2");
+#   endif
+}
+
+#endif
+
+static Function selectImplementation(const char **name)
+{
+#ifdef XOR_DECRYPT_X86
+    if (hasAvx2())
+    {
+        *name = "avx2";
+        return decryptAvx2;
+    }
+    *name = "sse2";
+    return decryptSse2;
+#else
+    *name = "scalar";
+    return decryptScalar;
+#endif
+}
+
+static const char *g_implementationName = nullptr;
+static const Function g_implementation = selectImplementation(&g_implementationName);
+
+void decrypt(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    g_implementation(dst, src, size);
+}
+void decrypt(uint8_t *dst, const uint8_t *src, size_t size, size_t position)
+{
+    // Bytes up to the next key start, then the vectorized kernels
+    const size_t head = std::min<size_t>((3 - position % 3) % 3, size);
+    const auto key = g_keyStream + position % 3;
+    for (size_t i = 0; i < head; ++i)
+        dst[i] = src[i] ^ key[i];
+
+    g_implementation(dst + head, src + head, size - head);
+}
+const char *getImplementationName()
+{
+    return g_implementationName;
+}
+
+}
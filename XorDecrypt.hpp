@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#   define XOR_DECRYPT_X86
+#endif
+
+// XOR with the repeating 3 byte game key, the key restarts at "src[0]"
+namespace XorDecrypt {
+
+using Function = void (*)(uint8_t *dst, const uint8_t *src, size_t size);
+
+// Fastest implementation supported by the CPU, selected on startup
+void decrypt(uint8_t *dst, const uint8_t *src, size_t size);
+const char *getImplementationName();
+
+// Same, "src" is at "position" in the key stream
+void decrypt(uint8_t *dst, const uint8_t *src, size_t size, size_t position);
+
+// Single field at "position" in the key stream
+template <typename T>
+inline T decryptValue(const uint8_t *src, size_t position);
+
+// Individual implementations, for benchmarks
+void decryptReference(uint8_t *dst, const uint8_t *src, size_t size); // Byte loop with "i % 3"
+void decryptScalar(uint8_t *dst, const uint8_t *src, size_t size); // 96 byte pattern, auto-vectorizable
+#ifdef XOR_DECRYPT_X86
+void decryptSse2(uint8_t *dst, const uint8_t *src, size_t size);
+void decryptAvx2(uint8_t *dst, const uint8_t *src, size_t size);
+bool hasAvx2();
+#endif
+
+// Key repeated, so any position modulo 3 can be followed by up to 9 bytes
+inline constexpr uint8_t g_keyStream[12] = {0x60, 0x3B, 0x0B, 0x60, 0x3B, 0x0B, 0x60, 0x3B, 0x0B, 0x60, 0x3B, 0x0B};
+
+template <typename T>
+inline T decryptValue(const uint8_t *src, size_t position)
+{
+    static_assert(sizeof(T) <= sizeof(g_keyStream) - 2);
+
+    uint8_t bytes[sizeof(T)];
+    const auto key = g_keyStream + position % 3;
+    for (size_t i = 0; i < sizeof(T); ++i)
+        bytes[i] = src[i] ^ key[i];
+
+    T value;
+    memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+}
@@ -0,0 +1,126 @@
+#include "Bench.hpp"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct Case
+{
+    string name;
+    string unit;
+    Bench::Function fn;
+};
+
+static vector<Case> &cases()
+{
+    static vector<Case> cases;
+    return cases;
+}
+
+bool Bench::add(const char *name, const char *unit, const Function &fn)
+{
+    cases().push_back({name, unit, fn});
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    // For benchmarks of QObject based code
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationVersion(MILU_DPS_METER_VERSION);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        {"json", "Also write the results as JSON to the file, \"-\" for standard output.", "file"},
+    });
+    parser.addPositionalArgument("filter", "Run only benchmarks whose name contains the text.");
+    parser.process(app);
+
+    const auto filter = parser.positionalArguments().value(0).toStdString();
+    const auto jsonFileName = parser.value("json");
+    const bool jsonToStdout = (jsonFileName == "-");
+
+    constexpr double minTime = 0.5;
+    constexpr int minIterations = 3;
+
+    QJsonArray results;
+
+    if (!jsonToStdout)
+        printf("%-40s %14s %16s\n", "benchmark", "time/iter [us]", "throughput");
+    for (auto &&c : cases())
+    {
+        if (!filter.empty() && c.name.find(filter) == string::npos)
+            continue;
+
+        c.fn(); // Warm-up
+
+        using Clock = chrono::steady_clock;
+
+        uint64_t items = 0;
+        int iterations = 0;
+        double time = 0.0;
+        const auto start = Clock::now();
+        while (iterations < minIterations || time < minTime)
+        {
+            items += c.fn();
+            ++iterations;
+            time = chrono::duration<double>(Clock::now() - start).count();
+        }
+
+        if (!jsonToStdout)
+        {
+            printf("%-40s %14.2f %12.2f M%s/s\n",
+                c.name.c_str(),
+                time * 1e6 / iterations,
+                items / time / 1e6,
+                c.unit.c_str()
+            );
+            fflush(stdout);
+        }
+
+        results.append(QJsonObject {
+            {"name", QString::fromStdString(c.name)},
+            {"unit", QString::fromStdString(c.unit)},
+            {"iterations", iterations},
+            {"time_per_iteration_us", time * 1e6 / iterations},
+            {"items_per_second", items / time},
+        });
+    }
+
+    if (jsonFileName.isEmpty())
+        return 0;
+
+    // Stable keys, so results of different versions can be compared
+    const QJsonObject report {
+        {"version", QCoreApplication::applicationVersion()},
+        {"benchmarks", results},
+    };
+    const auto json = QJsonDocument(report).toJson();
+
+    if (jsonToStdout)
+    {
+        fwrite(json.constData(), 1, json.size(), stdout);
+        return 0;
+    }
+
+    QFile file(jsonFileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size())
+    {
+        fprintf(stderr, "Can't write %s\n", qUtf8Printable(jsonFileName));
+        return 1;
+    }
+
+    return 0;
+}
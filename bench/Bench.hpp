@@ -0,0 +1,20 @@
+#pragma once
+
+#include <functional>
+#include <cstdint>
+
+namespace Bench {
+
+// Runs one iteration and returns the number of processed items
+using Function = std::function<uint64_t()>;
+
+bool add(const char *name, const char *unit, const Function &fn);
+
+template <typename T>
+inline void doNotOptimize(const T &value)
+{
+    static volatile uint64_t sink = 0;
+    sink = sink + static_cast<uint64_t>(value);
+}
+
+}
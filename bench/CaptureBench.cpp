@@ -0,0 +1,115 @@
+// Runs all live capture backends at the same time on their own threads, so they see the same traffic.
+// Needs root and traffic on the port (game client or e.g. iperf3 -p <port>).
+
+#include "PacketCapture.hpp"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QEventLoop>
+#include <QThread>
+#include <QTimer>
+#include <QDebug>
+
+#include <sys/resource.h>
+
+#include <cstdio>
+
+using namespace std;
+
+struct Result
+{
+    const char *name;
+    bool ok = false;
+    uint64_t packets = 0;
+    uint64_t drops = 0;
+    double cpuTime = 0.0;
+};
+
+static double threadCpuTime()
+{
+    rusage usage = {};
+    getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+         + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOptions({
+        {"port", "TCP port to capture (default: 15011).", "port", "15011"},
+        {"duration", "Measurement time in seconds (default: 10).", "seconds", "10"},
+        {"immediate", "Use the low latency capture profile."},
+        {"buffer-size", "Kernel capture buffer size in KiB (default: backend default).", "KiB", "0"},
+    });
+    parser.process(app);
+
+    const uint16_t port = parser.value("port").toUShort();
+    const int durationMs = parser.value("duration").toDouble() * 1000.0;
+
+    PacketCapture::Options options;
+    options.immediateMode = parser.isSet("immediate");
+    options.bufferSize = parser.value("buffer-size").toInt() * 1024;
+
+    Result results[] = {
+        {"pcap"},
+        {"tpacket"},
+    };
+    const PacketCapture::Backend backends[] = {
+        PacketCapture::Backend::PCap,
+        PacketCapture::Backend::TPacketV3,
+    };
+
+    vector<QThread *> threads;
+    for (size_t i = 0; i < size(results); ++i)
+    {
+        threads.push_back(QThread::create([&result = results[i], backend = backends[i], &options, port, durationMs] {
+            auto packetCapture = PacketCapture::create(backend, options);
+            if (!packetCapture->init(port))
+                return;
+
+            result.ok = true;
+
+            QEventLoop loop;
+            QTimer::singleShot(durationMs, &loop, &QEventLoop::quit);
+
+            const double cpuTime = threadCpuTime();
+            loop.exec();
+            result.cpuTime = threadCpuTime() - cpuTime;
+
+            result.packets = packetCapture->getNumPackets();
+            packetCapture->updateNumDrops();
+            result.drops = packetCapture->getNumDrops();
+        }));
+    }
+
+    for (auto thread : threads)
+        thread->start();
+    for (auto thread : threads)
+    {
+        thread->wait();
+        delete thread;
+    }
+
+    printf("%-8s %12s %10s %12s %12s\n", "backend", "packets", "drops", "cpu [ms]", "cpu/pkt [ns]");
+    for (auto &&result : results)
+    {
+        if (!result.ok)
+        {
+            printf("%-8s %12s\n", result.name, "init failed");
+            continue;
+        }
+        printf("%-8s %12llu %10llu %12.1f %12.0f\n",
+            result.name,
+            static_cast<unsigned long long>(result.packets),
+            static_cast<unsigned long long>(result.drops),
+            result.cpuTime * 1e3,
+            result.packets > 0 ? result.cpuTime * 1e9 / result.packets : 0.0
+        );
+    }
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include "Bench.hpp"
+
+#include "XorDecrypt.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t g_bufferSize = 1 << 20;
+
+// Typical game packets are short, damage packets are tens of bytes
+constexpr size_t g_packetSizes[] = {37, 61, 120, 250, 1460};
+
+const vector<uint8_t> &source()
+{
+    static const auto source = [] {
+        mt19937 rng(3);
+        vector<uint8_t> source(g_bufferSize);
+        for (auto &&b : source)
+            b = rng();
+        return source;
+    }();
+    return source;
+}
+
+// All implementations must produce the reference output, for any size and alignment
+void verify(XorDecrypt::Function fn, const char *name)
+{
+    const auto &src = source();
+    vector<uint8_t> expected(4096), actual(4096);
+    for (size_t offset = 0; offset < 64; ++offset)
+    {
+        for (size_t size = 0; size < 1024; ++size)
+        {
+            XorDecrypt::decryptReference(expected.data(), src.data() + offset, size);
+            fn(actual.data() + offset, src.data() + offset, size);
+            if (memcmp(expected.data(), actual.data() + offset, size) != 0)
+            {
+                fprintf(stderr, "decrypt/%s: output differs from reference (offset %zu, size %zu)\n", name, offset, size);
+                abort();
+            }
+        }
+    }
+}
+
+// Decrypts the buffer as a sequence of packets of the given size, like SWPacketCapture does
+Bench::Function makeBench(XorDecrypt::Function fn, const char *name, size_t packetSize)
+{
+    return [=, verified = false]() mutable {
+        if (!verified)
+        {
+            verify(fn, name);
+            verified = true;
+        }
+
+        static vector<uint8_t> dst(g_bufferSize);
+        const auto &src = source();
+
+        size_t offset = 0;
+        for (; offset + packetSize <= g_bufferSize; offset += packetSize)
+            fn(dst.data() + offset, src.data() + offset, packetSize);
+
+        Bench::doNotOptimize(dst[packetSize / 2]);
+        return static_cast<uint64_t>(offset);
+    };
+}
+
+bool addAll(XorDecrypt::Function fn, const char *name)
+{
+    for (auto packetSize : g_packetSizes)
+    {
+        const auto caseName = "decrypt/" + string(name) + "/" + to_string(packetSize);
+        Bench::add(caseName.c_str(), "B", makeBench(fn, name, packetSize));
+    }
+    return true;
+}
+
+const bool g_registered[] = {
+    addAll(XorDecrypt::decryptReference, "reference"),
+    addAll(XorDecrypt::decryptScalar, "scalar"),
+#ifdef XOR_DECRYPT_X86
+    addAll(XorDecrypt::decryptSse2, "sse2"),
+    XorDecrypt::hasAvx2() && addAll(XorDecrypt::decryptAvx2, "avx2"),
+#endif
+};
+
+}
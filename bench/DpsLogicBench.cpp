@@ -0,0 +1,87 @@
+#include "Bench.hpp"
+#include "Synthetic.hpp"
+
+#include "DpsLogic.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr uint32_t g_numEvents = 1 << 16;
+constexpr uint32_t g_numMonsters = 16;
+constexpr uint32_t g_numIterateCalls = 1000;
+
+// Party sizes, and a crowded open world field
+constexpr uint32_t g_numPlayers[] = {4, 8, 100};
+
+// Batches as the event queue hands them over
+constexpr size_t g_batchSize = 256;
+
+unique_ptr<DpsLogic> makeDpsLogic()
+{
+    auto dpsLogic = make_unique<DpsLogic>();
+    dpsLogic->setRealTime(false);
+    return dpsLogic;
+}
+
+void ingest(DpsLogic &dpsLogic, const vector<DpsEvent> &events)
+{
+    for (size_t i = 0; i < events.size(); i += g_batchSize)
+        dpsLogic.ingest(events.data() + i, min(g_batchSize, events.size() - i));
+}
+
+// Objects are created on first use, after the application object
+Bench::Function makeDamageBench(uint32_t nPlayers)
+{
+    return [=, events = vector<DpsEvent>()]() mutable {
+        if (events.empty())
+            events = Synthetic::makeDamageEvents(g_numEvents, nPlayers, g_numMonsters, 1);
+
+        auto dpsLogic = makeDpsLogic();
+        ingest(*dpsLogic, events);
+        Bench::doNotOptimize(dpsLogic->getNumPlayers());
+        return uint64_t(g_numEvents);
+    };
+}
+
+Bench::Function makeIterateBench(uint32_t nPlayers, uint32_t maxPlayers = UINT32_MAX)
+{
+    return [=, dpsLogic = shared_ptr<DpsLogic>()]() mutable {
+        if (!dpsLogic)
+        {
+            dpsLogic = makeDpsLogic();
+            ingest(*dpsLogic, Synthetic::makeDamageEvents(g_numEvents, nPlayers, g_numMonsters, 1));
+        }
+
+        uint64_t sum = 0;
+        for (uint32_t i = 0; i < g_numIterateCalls; ++i)
+        {
+            dpsLogic->iterate([&](uint32_t idx, const QString &playerName, uint8_t characterClass, uint64_t totalDamage, const DpsLogic::PlayerStats &playerStats) {
+                sum += idx + playerName.size() + characterClass + totalDamage + playerStats.damage;
+            }, maxPlayers);
+        }
+        Bench::doNotOptimize(sum);
+        return uint64_t(g_numIterateCalls);
+    };
+}
+
+bool addAll()
+{
+    for (auto nPlayers : g_numPlayers)
+    {
+        const auto suffix = "/" + to_string(nPlayers);
+        Bench::add(("dpslogic/damage" + suffix).c_str(), "events", makeDamageBench(nPlayers));
+        Bench::add(("dpslogic/iterate" + suffix).c_str(), "calls", makeIterateBench(nPlayers));
+        Bench::add(("dpslogic/iterate_top4" + suffix).c_str(), "calls", makeIterateBench(nPlayers, 4));
+    }
+    return true;
+}
+
+const bool g_registered = addAll();
+
+}
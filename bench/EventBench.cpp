@@ -0,0 +1,122 @@
+#include "Bench.hpp"
+#include "Synthetic.hpp"
+
+#include "DpsEvent.hpp"
+#include "DpsLogic.hpp"
+
+#include <QCoreApplication>
+#include <QObject>
+
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t g_numEvents = 1 << 16;
+
+// Events decoded from one TCP segment, a busy fight carries a few damage records per segment
+constexpr size_t g_batchSize = 8;
+
+// Events the GUI thread hands to DpsLogic at once, as EventQueue drains them
+constexpr size_t g_drainBatchSize = 256;
+
+const vector<DpsEvent> &events()
+{
+    static const auto events = Synthetic::makeDamageEvents(g_numEvents, 4, 16, 5);
+    return events;
+}
+
+// Per-hit signal, as the decoder delivered events before
+class SignalSource : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void damage(int64_t timestamp, uint32_t srcId, uint16_t combo, uint32_t dstId, uint32_t dmg, uint32_t ssDmg, bool miss, bool crit);
+};
+
+uint64_t g_sink = 0;
+
+void sinkDamage(int64_t timestamp, uint32_t srcId, uint16_t combo, uint32_t dstId, uint32_t dmg, uint32_t ssDmg, bool miss, bool crit)
+{
+    g_sink += timestamp + srcId + combo + dstId + dmg + ssDmg + miss + crit;
+}
+void sinkEvents(const DpsEvent *events, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto &e = events[i].damage;
+        g_sink += events[i].timestamp + e.srcId + e.combo + e.dstId + e.dmg + e.ssDmg + e.miss + e.crit;
+    }
+}
+
+uint64_t emitSignals(SignalSource &source)
+{
+    for (auto &&event : events())
+    {
+        const auto &e = event.damage;
+        emit source.damage(event.timestamp, e.srcId, e.combo, e.dstId, e.dmg, e.ssDmg, e.miss, e.crit);
+    }
+    return g_numEvents;
+}
+
+Bench::Function makeSignalBench(Qt::ConnectionType connectionType)
+{
+    // Created on first use, after the application object
+    return [=, source = shared_ptr<SignalSource>()]() mutable {
+        if (!source)
+        {
+            source = make_shared<SignalSource>();
+            QObject::connect(source.get(), &SignalSource::damage, source.get(), &sinkDamage, connectionType);
+        }
+
+        const auto n = emitSignals(*source);
+        if (connectionType == Qt::QueuedConnection)
+            QCoreApplication::sendPostedEvents(source.get());
+        Bench::doNotOptimize(g_sink);
+        return n;
+    };
+}
+
+const bool g_registered = [] {
+    Bench::add("events/signal direct", "events", makeSignalBench(Qt::DirectConnection));
+    Bench::add("events/signal queued", "events", makeSignalBench(Qt::QueuedConnection));
+    Bench::add("events/batch", "events", [] {
+        const function<void(const DpsEvent *, size_t)> consumer = &sinkEvents;
+        const auto &e = events();
+        for (size_t i = 0; i < g_numEvents; i += g_batchSize)
+            consumer(e.data() + i, g_batchSize);
+        Bench::doNotOptimize(g_sink);
+        return uint64_t(g_numEvents);
+    });
+
+    // Consumer side, every damage event requests a UI update
+    Bench::add("events/dpslogic per event", "events", [] {
+        DpsLogic dpsLogic;
+        dpsLogic.setRealTime(false);
+        uint64_t nUpdates = 0;
+        QObject::connect(&dpsLogic, &DpsLogic::update, [&] { ++nUpdates; });
+        for (auto &&event : events())
+            dpsLogic.processEvent(event);
+        Bench::doNotOptimize(nUpdates);
+        return uint64_t(g_numEvents);
+    });
+    Bench::add("events/dpslogic batch", "events", [] {
+        DpsLogic dpsLogic;
+        dpsLogic.setRealTime(false);
+        uint64_t nUpdates = 0;
+        QObject::connect(&dpsLogic, &DpsLogic::update, [&] { ++nUpdates; });
+        const auto &e = events();
+        for (size_t i = 0; i < g_numEvents; i += g_drainBatchSize)
+            dpsLogic.ingest(e.data() + i, g_drainBatchSize);
+        Bench::doNotOptimize(nUpdates);
+        return uint64_t(g_numEvents);
+    });
+    return true;
+}();
+
+}
+
+#include "EventBench.moc"
@@ -0,0 +1,106 @@
+#include "Bench.hpp"
+#include "Synthetic.hpp"
+
+#include "DpsLogic.hpp"
+#include "EventLog.hpp"
+
+#include <QDir>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr uint32_t g_numEvents = 1 << 20;
+constexpr size_t g_writeBatchSize = 256;
+
+const vector<DpsEvent> &events()
+{
+    static const auto events = Synthetic::makeDamageEvents(g_numEvents, 8, 16, 7);
+    return events;
+}
+
+// The log which is read stays mapped, so writing uses its own file
+QString fileName(bool forReading)
+{
+    return QDir::temp().filePath(forReading ? "MiluDpsMeterBench.evlog" : "MiluDpsMeterBench-write.evlog");
+}
+
+uint64_t write(const QString &fileName)
+{
+    const auto &e = events();
+
+    EventLogWriter writer;
+    if (!writer.open(fileName))
+        abort();
+    for (size_t i = 0; i < e.size(); i += g_writeBatchSize)
+        writer.add(e.data() + i, min(g_writeBatchSize, e.size() - i));
+    if (!writer.finish())
+        abort();
+
+    return g_numEvents;
+}
+
+const EventLogReader &reader()
+{
+    static const auto reader = [] {
+        write(fileName(true));
+
+        auto eventLog = make_unique<EventLogReader>();
+        if (!eventLog->open(fileName(true)) || eventLog->getNumEvents() != g_numEvents)
+            abort();
+
+        const auto fileSize = QFileInfo(fileName(true)).size();
+        fprintf(stderr, "Event log: %u events, %.1f bytes/event (%zu in memory)\n",
+            g_numEvents, fileSize / double(g_numEvents), sizeof(DpsEvent));
+
+        // Must read back exactly what was written
+        size_t idx = 0;
+        eventLog->read([&](const DpsEvent *decoded, size_t count) {
+            for (size_t i = 0; i < count; ++i, ++idx)
+            {
+                const auto &a = decoded[i], &b = events()[idx];
+                if (a.timestamp != b.timestamp || memcmp(&a.damage, &b.damage, sizeof(a.damage)) != 0)
+                    abort();
+            }
+        });
+        return eventLog;
+    }();
+    return *reader;
+}
+
+uint64_t decode()
+{
+    uint64_t sum = 0;
+    reader().read([&](const DpsEvent *events, size_t count) {
+        sum += events[count - 1].damage.dmg + count;
+    });
+    Bench::doNotOptimize(sum);
+    return g_numEvents;
+}
+
+uint64_t ingest()
+{
+    DpsLogic dpsLogic;
+    dpsLogic.setRealTime(false);
+    reader().read([&](const DpsEvent *events, size_t count) {
+        dpsLogic.ingest(events, count);
+    });
+    Bench::doNotOptimize(dpsLogic.getNumPlayers());
+    return g_numEvents;
+}
+
+const bool g_registered[] = {
+    Bench::add("eventlog/write", "events", [] { return write(fileName(false)); }),
+    Bench::add("eventlog/decode", "events", decode),
+    Bench::add("eventlog/ingest", "events", ingest),
+};
+
+}
@@ -0,0 +1,238 @@
+#include "Bench.hpp"
+#include "Synthetic.hpp"
+
+#include "DecoderShards.hpp"
+#include "DpsLogic.hpp"
+#include "EventQueue.hpp"
+#include "PacketCapture.hpp"
+#include "SWPacketCapture.hpp"
+
+#include <QCoreApplication>
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Feeds packets from memory, the stages after the capture backend
+class MemoryCapture : public PacketCapture
+{
+public:
+    bool init(uint16_t port) override
+    {
+        m_port = port;
+        return true;
+    }
+
+    void process(const vector<vector<uint8_t>> &packets, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            m_timestamp += 100'000;
+            processPacket(packets[i].data(), packets[i].size(), m_timestamp);
+        }
+        flushFlowChanges();
+    }
+
+private:
+    int64_t m_timestamp = 0;
+};
+
+const vector<uint8_t> &gameStream()
+{
+    static const auto stream = Synthetic::makeGameStream({});
+    return stream;
+}
+
+const vector<vector<uint8_t>> &tcpPackets(bool reorder)
+{
+    static const vector<vector<uint8_t>> packets[] = {
+        Synthetic::makeTcpPackets(gameStream(), false),
+        Synthetic::makeTcpPackets(gameStream(), true),
+    };
+    return packets[reorder];
+}
+
+// Interleaved packets of several game clients, each with its own connection and stream
+struct ClientTraffic
+{
+    vector<vector<uint8_t>> packets;
+    uint64_t nBytes = 0;
+};
+
+const ClientTraffic &clientTraffic()
+{
+    static const auto traffic = [] {
+        constexpr uint32_t nClients = 8;
+
+        vector<vector<vector<uint8_t>>> clients;
+        ClientTraffic traffic;
+        for (uint32_t i = 0; i < nClients; ++i)
+        {
+            Synthetic::StreamOptions options;
+            options.seed = i + 1;
+            const auto stream = Synthetic::makeGameStream(options);
+            clients.push_back(Synthetic::makeTcpPackets(stream, false, 50000 + i));
+            traffic.nBytes += stream.size();
+        }
+        for (size_t p = 0; ; ++p)
+        {
+            bool any = false;
+            for (auto &&packets : clients)
+            {
+                if (p < packets.size())
+                {
+                    traffic.packets.push_back(packets[p]);
+                    any = true;
+                }
+            }
+            if (!any)
+                break;
+        }
+        return traffic;
+    }();
+    return traffic;
+}
+
+// Offset and size of random segments of the game stream, so game packets span segments
+const vector<pair<size_t, size_t>> &segments(bool small)
+{
+    static const auto makeSegments = [](size_t maxSegmentSize) {
+        mt19937 rng(4);
+        const auto &stream = gameStream();
+        vector<pair<size_t, size_t>> segments;
+        for (size_t offset = 0; offset < stream.size();)
+        {
+            const size_t len = min<size_t>(1 + rng() % maxSegmentSize, stream.size() - offset);
+            segments.emplace_back(offset, len);
+            offset += len;
+        }
+        return segments;
+    };
+    static const vector<pair<size_t, size_t>> segments[] = {
+        makeSegments(1460),
+        makeSegments(64),
+    };
+    return segments[small];
+}
+
+uint64_t runFraming(bool smallSegments, bool lazyDecrypt)
+{
+    const auto &stream = gameStream();
+
+    uint64_t nEvents = 0;
+    SWPacketCapture swPacketCapture;
+    swPacketCapture.setLazyDecrypt(lazyDecrypt);
+    swPacketCapture.setEventConsumer([&](const DpsEvent *, size_t count) {
+        nEvents += count;
+    });
+
+    int64_t timestamp = 0;
+    for (auto &&[offset, len] : segments(smallSegments))
+        swPacketCapture.newPacket(0, stream.data() + offset, len, ++timestamp);
+
+    Bench::doNotOptimize(nEvents);
+    return stream.size();
+}
+
+uint64_t runCapture(bool reorder)
+{
+    uint64_t nBytes = 0;
+    MemoryCapture capture;
+    capture.init(Synthetic::g_serverPort);
+    QObject::connect(
+        &capture, &PacketCapture::newPacket,
+        &capture, [&](uint32_t, const uint8_t *, qsizetype len, int64_t) {
+            nBytes += len;
+        },
+        Qt::DirectConnection
+    );
+    capture.process(tcpPackets(reorder), 0, tcpPackets(reorder).size());
+
+    if (nBytes != gameStream().size())
+        fprintf(stderr, "Capture delivered %llu of %zu bytes\n", static_cast<unsigned long long>(nBytes), gameStream().size());
+
+    return tcpPackets(reorder).size();
+}
+
+// Every stage of the live meter on one thread: TCP/IP, reassembly, framing, decryption,
+// decoding, the event queue and DpsLogic
+uint64_t runPipeline(bool reorder)
+{
+    MemoryCapture capture;
+    capture.init(Synthetic::g_serverPort);
+
+    SWPacketCapture swPacketCapture;
+    QObject::connect(&capture, &PacketCapture::newPacket, &swPacketCapture, &SWPacketCapture::newPacket, Qt::DirectConnection);
+    QObject::connect(&capture, &PacketCapture::flowReset, &swPacketCapture, &SWPacketCapture::resetFlow, Qt::DirectConnection);
+
+    DpsLogic dpsLogic;
+    dpsLogic.setRealTime(false);
+
+    EventQueue eventQueue(1 << 16);
+    eventQueue.setConsumer([&](const DpsEvent *events, size_t count) {
+        dpsLogic.ingest(events, count);
+    });
+    swPacketCapture.setEventConsumer([&](const DpsEvent *events, size_t count) {
+        eventQueue.push(events, count);
+    });
+
+    // The GUI thread drains the queue every few packets
+    const auto &packets = tcpPackets(reorder);
+    constexpr size_t drainInterval = 16;
+    for (size_t i = 0; i < packets.size(); i += drainInterval)
+    {
+        capture.process(packets, i, min(i + drainInterval, packets.size()));
+        QCoreApplication::sendPostedEvents(&eventQueue);
+    }
+
+    if (eventQueue.getNumOverflows() > 0)
+        fprintf(stderr, "Pipeline lost %llu events\n", static_cast<unsigned long long>(eventQueue.getNumOverflows()));
+
+    Bench::doNotOptimize(dpsLogic.getNumPlayers());
+    return gameStream().size();
+}
+
+// Connections of several clients decoded by "nWorkers" threads, up to the merged event stream
+uint64_t runSharded(uint32_t nWorkers)
+{
+    const auto &traffic = clientTraffic();
+
+    uint64_t nEvents = 0;
+    DecoderShards shards(nWorkers);
+    shards.setBlocking(true);
+    shards.setEventConsumer([&](const DpsEvent *, size_t count) {
+        nEvents += count;
+    });
+    shards.start(Synthetic::g_serverPort);
+
+    int64_t timestamp = 0;
+    for (auto &&packet : traffic.packets)
+        shards.addPacket(packet.data(), packet.size(), timestamp += 100'000);
+    shards.flush();
+    shards.stop();
+
+    Bench::doNotOptimize(nEvents);
+    return traffic.nBytes;
+}
+
+const bool g_registered[] = {
+    Bench::add("framing/mss_segments", "B", [] { return runFraming(false, false); }),
+    Bench::add("framing/small_segments", "B", [] { return runFraming(true, false); }),
+    Bench::add("framing/mss_segments_lazy", "B", [] { return runFraming(false, true); }),
+    Bench::add("capture/in_order", "pkt", [] { return runCapture(false); }),
+    Bench::add("capture/reorder", "pkt", [] { return runCapture(true); }),
+    Bench::add("pipeline/in_order", "B", [] { return runPipeline(false); }),
+    Bench::add("pipeline/reorder", "B", [] { return runPipeline(true); }),
+    Bench::add("pipeline/sharded/1", "B", [] { return runSharded(1); }),
+    Bench::add("pipeline/sharded/2", "B", [] { return runSharded(2); }),
+    Bench::add("pipeline/sharded/4", "B", [] { return runSharded(4); }),
+    Bench::add("pipeline/sharded/8", "B", [] { return runSharded(8); }),
+};
+
+}
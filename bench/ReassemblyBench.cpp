@@ -0,0 +1,180 @@
+#include "Bench.hpp"
+
+#include "TcpReassembly.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+enum Scenario
+{
+    InOrder,
+    Reorder,
+    Duplicate,
+    Loss,
+};
+
+struct Segment
+{
+    uint32_t offset;
+    uint32_t len;
+};
+
+constexpr uint32_t g_streamSize = 4 << 20;
+constexpr uint32_t g_maxSegmentSize = 1460;
+constexpr uint32_t g_initialSeq = 0xffffffff - g_streamSize / 2; // Crosses sequence number wrap
+
+const vector<uint8_t> &stream()
+{
+    static const auto stream = [] {
+        mt19937 rng(1);
+        vector<uint8_t> stream(g_streamSize);
+        for (auto &&b : stream)
+            b = rng();
+        return stream;
+    }();
+    return stream;
+}
+
+vector<Segment> makeSegments(Scenario scenario)
+{
+    mt19937 rng(2);
+
+    vector<Segment> segments;
+    for (uint32_t offset = 0; offset < g_streamSize; offset += g_maxSegmentSize)
+        segments.push_back({offset, min(g_maxSegmentSize, g_streamSize - offset)});
+
+    switch (scenario)
+    {
+        case InOrder:
+            break;
+        case Reorder:
+            // 10% of segments arrive up to 8 segments late
+            for (size_t i = 0; i + 8 < segments.size(); ++i)
+            {
+                if (rng() % 10 == 0)
+                    swap(segments[i], segments[i + 1 + rng() % 7]);
+            }
+            break;
+        case Duplicate:
+        {
+            // 5% of segments are retransmitted, 5% partially
+            vector<Segment> out;
+            for (auto &&segment : segments)
+            {
+                out.push_back(segment);
+                if (rng() % 20 == 0)
+                    out.push_back(segment);
+                if (rng() % 20 == 0)
+                {
+                    const uint32_t skip = rng() % segment.len;
+                    out.push_back({segment.offset + skip, segment.len - skip});
+                }
+            }
+            segments = move(out);
+            break;
+        }
+        case Loss:
+        {
+            // 0.5% of segments never arrive, plus reordering
+            vector<Segment> out;
+            for (auto &&segment : segments)
+            {
+                if (rng() % 200 != 0)
+                    out.push_back(segment);
+            }
+            for (size_t i = 0; i + 8 < out.size(); ++i)
+            {
+                if (rng() % 10 == 0)
+                    swap(out[i], out[i + 1 + rng() % 7]);
+            }
+            segments = move(out);
+            break;
+        }
+    }
+
+    return segments;
+}
+
+// A segment too far ahead after buffered data which reaches past its start, once skipping the gap
+// delivered the buffer, only the rest of the segment may follow
+bool checkOverlapAfterGap()
+{
+    constexpr uint32_t initialSeq = 0xfffff000;
+    constexpr uint32_t bufferedOffset = 240 << 10;
+    constexpr uint32_t bufferedLen = 16 << 10;
+    constexpr uint32_t farOffset = 250 << 10;
+    constexpr uint32_t farLen = 10 << 10;
+
+    const auto data = stream().data();
+
+    TcpReassembly reassembly;
+    reassembly.reset(initialSeq);
+
+    uint64_t position = 0;
+    bool ok = true;
+    const auto dataFn = [&](const uint8_t *segment, uint32_t len) {
+        ok = ok && (position + len <= g_streamSize) && equal(segment, segment + len, data + position);
+        position += len;
+    };
+    const auto gapFn = [&](uint32_t lostBytes) {
+        position += lostBytes;
+    };
+
+    reassembly.push(initialSeq + bufferedOffset, data + bufferedOffset, bufferedLen, 1, dataFn, gapFn);
+    reassembly.push(initialSeq + farOffset, data + farOffset, farLen, 2, dataFn, gapFn);
+
+    const auto &stats = reassembly.getStats();
+    ok = ok && (position == farOffset + farLen) && (stats.lostBytes == bufferedOffset) && (stats.gaps == 1);
+    if (!ok)
+        fprintf(stderr, "Reassembly of a segment overlapping data buffered before a gap is wrong\n");
+    return ok;
+}
+
+uint64_t run(Scenario scenario)
+{
+    [[maybe_unused]] static const bool overlapChecked = checkOverlapAfterGap();
+
+    static vector<Segment> segments[4];
+    if (segments[scenario].empty())
+        segments[scenario] = makeSegments(scenario);
+
+    const auto data = stream().data();
+
+    TcpReassembly reassembly;
+    reassembly.reset(g_initialSeq);
+
+    uint64_t delivered = 0;
+    int64_t time = 0;
+    for (auto &&segment : segments[scenario])
+    {
+        reassembly.push(g_initialSeq + segment.offset, data + segment.offset, segment.len, ++time,
+            [&](const uint8_t *data, uint32_t len) {
+                delivered += len;
+                Bench::doNotOptimize(data[len - 1]);
+            },
+            [&](uint32_t lostBytes) {
+                delivered += lostBytes;
+            }
+        );
+    }
+
+    if (delivered != g_streamSize && scenario != Loss)
+        fprintf(stderr, "Reassembly delivered %llu of %u bytes\n", static_cast<unsigned long long>(delivered), g_streamSize);
+
+    return g_streamSize;
+}
+
+const bool g_registered[] = {
+    Bench::add("reassembly/in_order", "B", [] { return run(InOrder); }),
+    Bench::add("reassembly/reorder", "B", [] { return run(Reorder); }),
+    Bench::add("reassembly/duplicate", "B", [] { return run(Duplicate); }),
+    Bench::add("reassembly/loss", "B", [] { return run(Loss); }),
+};
+
+}
@@ -0,0 +1,206 @@
+#include "Synthetic.hpp"
+
+#include "SWPacketStructs.hpp"
+#include "XorDecrypt.hpp"
+
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+
+using namespace std;
+using namespace Packet;
+
+namespace Synthetic {
+
+namespace {
+
+// Builds one game packet, records are filled through the layout descriptors
+class PacketWriter
+{
+public:
+    PacketWriter(OpCode opCode)
+        : m_packet(sizeof(Header) + sizeof(OpCode))
+    {
+        qToBigEndian(static_cast<uint16_t>(opCode), m_packet.data() + sizeof(Header));
+    }
+
+    // Returns the offset of the record
+    size_t add(size_t size)
+    {
+        const auto offset = m_packet.size();
+        m_packet.resize(offset + size);
+        return offset;
+    }
+    void add(const void *data, size_t size)
+    {
+        const auto offset = add(size);
+        memcpy(m_packet.data() + offset, data, size);
+    }
+
+    template <typename F>
+    void set(size_t offset, typename F::Type value)
+    {
+        memcpy(m_packet.data() + offset + F::offset, &value, sizeof(value));
+    }
+
+    void finish(vector<uint8_t> &stream)
+    {
+        const Header header {2, static_cast<uint16_t>(m_packet.size()), 1};
+        memcpy(m_packet.data(), &header, sizeof(header));
+
+        // Encryption is the same XOR as decryption
+        const auto payload = m_packet.data() + sizeof(Header);
+        XorDecrypt::decryptReference(payload, payload, m_packet.size() - sizeof(Header));
+
+        stream.insert(stream.end(), m_packet.begin(), m_packet.end());
+    }
+
+private:
+    vector<uint8_t> m_packet;
+};
+
+template <typename T>
+void put(vector<uint8_t> &packet, size_t offset, T value)
+{
+    memcpy(packet.data() + offset, &value, sizeof(value));
+}
+
+}
+
+vector<uint8_t> makeGameStream(const StreamOptions &options)
+{
+    mt19937 rng(options.seed);
+    vector<uint8_t> stream;
+
+    {
+        PacketWriter packet(OpCode::WorldChange);
+        const auto message = packet.add(WorldChange::size);
+        packet.set<WorldChange::Id>(message, 1);
+        packet.set<WorldChange::WorldId>(message, 20001);
+        packet.finish(stream);
+    }
+
+    // Party messages carry at most a handful of players, larger groups only exist in the benchmark
+    {
+        PacketWriter packet(OpCode::Party);
+        const auto message = packet.add(Party::size);
+        packet.set<Party::PartyHostId>(message, 1);
+        packet.set<Party::PlayerCount>(message, min<uint32_t>(options.nPlayers, 255));
+        for (uint32_t i = 0; i < min<uint32_t>(options.nPlayers, 255); ++i)
+        {
+            const auto nick = u"Player" + u16string(1, u'A' + i % 26);
+            const auto partyData = packet.add(PartyData::size);
+            packet.set<PartyData::PlayerId>(partyData, 1 + i);
+            packet.set<PartyData::NickSize>(partyData, nick.size() * sizeof(char16_t));
+            packet.add(nick.data(), nick.size() * sizeof(char16_t));
+            const auto partyDataTail = packet.add(PartyDataTail::stride);
+            packet.set<PartyDataTail::CharacterClass>(partyDataTail, 1 + i % 8);
+        }
+        packet.finish(stream);
+    }
+
+    for (uint32_t i = 0; i < options.nPackets; ++i)
+    {
+        if (rng() % 100 < 15)
+        {
+            // Movement and other traffic the meter doesn't read
+            PacketWriter packet(static_cast<OpCode>(0x0106));
+            packet.add(100 + rng() % 200);
+            packet.finish(stream);
+            continue;
+        }
+
+        PacketWriter packet(OpCode::Damage);
+        const uint8_t nMonsters = 1 + rng() % 3;
+        packet.set<Damage::MonsterCount>(packet.add(Damage::size), nMonsters);
+        for (uint8_t m = 0; m < nMonsters; ++m)
+        {
+            const auto damageMonster = packet.add(DamageMonster::size);
+            packet.set<DamageMonster::MonsterId>(damageMonster, g_firstMonsterId + rng() % options.nMonsters);
+            packet.set<DamageMonster::DamageType>(damageMonster, (rng() % 10 == 0) ? 0x01 : (rng() % 4 == 0) ? 0x04 : 0x00);
+            packet.set<DamageMonster::TotalDmg>(damageMonster, rng() % 100'000);
+            packet.set<DamageMonster::SoulstoneDmg>(damageMonster, (rng() % 8 == 0) ? rng() % 10'000 : 0);
+            packet.set<DamageMonster::RemainHp>(damageMonster, rng() % 10'000'000);
+        }
+        const auto damagePlayer = packet.add(DamagePlayer::size);
+        packet.set<DamagePlayer::PlayerId>(damagePlayer, 1 + rng() % options.nPlayers);
+        packet.set<DamagePlayer::SkillId>(damagePlayer, 10000 + rng() % 32);
+        packet.set<DamagePlayer::MaxCombo>(damagePlayer, rng() % 200);
+        packet.finish(stream);
+    }
+
+    return stream;
+}
+
+vector<DpsEvent> makeDamageEvents(uint32_t count, uint32_t nPlayers, uint32_t nMonsters, uint32_t seed)
+{
+    mt19937 rng(seed);
+    vector<DpsEvent> events(count);
+    int64_t timestamp = 0;
+    for (auto &&event : events)
+    {
+        timestamp += 1'000'000;
+        event.type = DpsEvent::Type::Damage;
+        event.timestamp = timestamp;
+        event.damage.srcId = 1 + rng() % nPlayers;
+        event.damage.dstId = g_firstMonsterId + rng() % nMonsters;
+        event.damage.dmg = rng() % 100'000;
+        event.damage.ssDmg = (rng() % 8 == 0) ? rng() % 10'000 : 0;
+        event.damage.skillId = 10000 + rng() % 32;
+        event.damage.remainHp = rng() % 10'000'000;
+        event.damage.combo = rng() % 200;
+        event.damage.miss = (rng() % 10 == 0);
+        event.damage.crit = (rng() % 4 == 0);
+    }
+    return events;
+}
+
+vector<vector<uint8_t>> makeTcpPackets(const vector<uint8_t> &stream, bool reorder, uint16_t clientPort)
+{
+    constexpr size_t ipHeaderSize = 20;
+    constexpr size_t tcpHeaderSize = 20;
+    constexpr size_t maxSegmentSize = 1460;
+    constexpr uint32_t initialSeq = 0x12345678;
+
+    vector<vector<uint8_t>> packets;
+    for (size_t offset = 0; offset < stream.size(); offset += maxSegmentSize)
+    {
+        const auto len = min(maxSegmentSize, stream.size() - offset);
+
+        auto &packet = packets.emplace_back(ipHeaderSize + tcpHeaderSize + len);
+
+        packet[0] = 0x45; // IPv4, 5 words
+        put(packet, 2, qToBigEndian<uint16_t>(packet.size()));
+        packet[8] = 64; // TTL
+        packet[9] = 6; // TCP
+        put(packet, 12, qToBigEndian<uint32_t>(0x0a000001)); // 10.0.0.1
+        put(packet, 16, qToBigEndian<uint32_t>(0x0a000002)); // 10.0.0.2
+
+        const auto tcp = ipHeaderSize;
+        put(packet, tcp + 0, qToBigEndian<uint16_t>(g_serverPort));
+        put(packet, tcp + 2, qToBigEndian<uint16_t>(clientPort));
+        put(packet, tcp + 4, qToBigEndian<uint32_t>(initialSeq + offset));
+        packet[tcp + 12] = 5 << 4; // 5 words
+        packet[tcp + 13] = 0x18; // PSH, ACK
+
+        memcpy(packet.data() + ipHeaderSize + tcpHeaderSize, stream.data() + offset, len);
+    }
+
+    if (reorder)
+    {
+        // The first packet stays in place, it establishes the flow
+        mt19937 rng(2);
+        for (size_t i = 1; i + 8 < packets.size(); ++i)
+        {
+            if (rng() % 10 == 0)
+                swap(packets[i], packets[i + 1 + rng() % 7]);
+        }
+    }
+
+    return packets;
+}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "DpsEvent.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Deterministic traffic for benchmarks, shaped like a party fighting in a dungeon
+namespace Synthetic {
+
+constexpr uint16_t g_serverPort = 15011;
+constexpr uint32_t g_firstMonsterId = 1073741824; // Ids from here on are not players
+
+struct StreamOptions
+{
+    uint32_t nPlayers = 4;
+    uint32_t nMonsters = 16;
+    uint32_t nPackets = 20'000;
+    uint32_t seed = 1;
+};
+
+// Encrypted game byte stream: world change and party list, then mostly damage with some unknown opcodes
+std::vector<uint8_t> makeGameStream(const StreamOptions &options);
+
+// Decoded damage events between "nPlayers" players and "nMonsters" monsters, 1 ms apart
+std::vector<DpsEvent> makeDamageEvents(uint32_t count, uint32_t nPlayers, uint32_t nMonsters, uint32_t seed);
+
+// IPv4/TCP packets carrying the stream from the server, up to 1460 bytes of payload each,
+// 10% arrive up to 8 packets late when reordering, the client port tells connections apart
+std::vector<std::vector<uint8_t>> makeTcpPackets(const std::vector<uint8_t> &stream, bool reorder, uint16_t clientPort = 50000);
+
+}
@@ -0,0 +1,298 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTimer>
+#include <QDebug>
+
+#include "DpsLogic.hpp"
+#include "EventLog.hpp"
+#include "Meter.hpp"
+
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+
+using namespace std;
+
+namespace {
+
+atomic_bool g_stopRequested = false;
+
+// Per-player rows, the columns of the GUI table plus time and world
+class Report
+{
+public:
+    enum class Format
+    {
+        Csv,
+        Json, // One object per line
+    };
+
+public:
+    bool open(const QString &fileName, Format format, uint32_t maxPlayers)
+    {
+        m_format = format;
+        m_maxPlayers = maxPlayers;
+        if (fileName.isEmpty())
+            return m_file.open(stdout, QIODevice::WriteOnly);
+        m_file.setFileName(fileName);
+        return m_file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+
+    void write(const DpsLogic &dpsLogic)
+    {
+        double time = dpsLogic.getTime();
+        if (qIsNaN(time))
+            time = 0.0;
+        const double rateTime = (time > 0.0) ? time : 1.0;
+        const auto worldId = dpsLogic.getWorldId();
+
+        if (m_format == Format::Csv && !m_headerWritten)
+        {
+            m_file.write("time,world,rank,player,class,damage,dps,dps_5s,dps_30s,dps_60s,peak_dps,share,damage_received,hits,hits_per_second,max_combo,miss_rate,crit_rate,soulstone_rate\n");
+            m_headerWritten = true;
+        }
+
+        QJsonArray players;
+        dpsLogic.iterate([&](uint32_t idx, const QString &playerName, uint8_t characterClass, uint64_t totalDamage, const DpsLogic::PlayerStats &playerStats) {
+            const double share = (totalDamage > 0) ? static_cast<double>(playerStats.damage) / totalDamage : 0.0;
+            const double hits = qMax<uint64_t>(playerStats.hits, 1);
+
+            if (m_format == Format::Csv)
+            {
+                QString name = playerName;
+                name.replace('"', "\"\"");
+                m_file.write(QString("%1,%2,%3,\"%4\",%5,%6,%7,%8,%9,%10,%11,%12,%13,%14,%15,%16,%17,%18,%19\n")
+                    .arg(time, 0, 'f', 3)
+                    .arg(worldId)
+                    .arg(idx + 1)
+                    .arg(name)
+                    .arg(characterClass)
+                    .arg(playerStats.damage)
+                    .arg(playerStats.damage / rateTime, 0, 'f', 0)
+                    .arg(playerStats.dps5s, 0, 'f', 0)
+                    .arg(playerStats.dps30s, 0, 'f', 0)
+                    .arg(playerStats.dps60s, 0, 'f', 0)
+                    .arg(playerStats.peakDps, 0, 'f', 0)
+                    .arg(share, 0, 'f', 4)
+                    .arg(playerStats.damageReceived)
+                    .arg(playerStats.hits)
+                    .arg(playerStats.hits / rateTime, 0, 'f', 2)
+                    .arg(playerStats.maxCombo)
+                    .arg(playerStats.misses / hits, 0, 'f', 4)
+                    .arg(playerStats.crits / hits, 0, 'f', 4)
+                    .arg(playerStats.soulstones / hits, 0, 'f', 4)
+                    .toUtf8()
+                );
+            }
+            else
+            {
+                players.append(QJsonObject {
+                    {"rank", static_cast<int>(idx + 1)},
+                    {"player", playerName},
+                    {"class", characterClass},
+                    {"damage", static_cast<double>(playerStats.damage)},
+                    {"dps", playerStats.damage / rateTime},
+                    {"dps_5s", playerStats.dps5s},
+                    {"dps_30s", playerStats.dps30s},
+                    {"dps_60s", playerStats.dps60s},
+                    {"peak_dps", playerStats.peakDps},
+                    {"share", share},
+                    {"damage_received", static_cast<double>(playerStats.damageReceived)},
+                    {"hits", static_cast<double>(playerStats.hits)},
+                    {"hits_per_second", playerStats.hits / rateTime},
+                    {"max_combo", playerStats.maxCombo},
+                    {"miss_rate", playerStats.misses / hits},
+                    {"crit_rate", playerStats.crits / hits},
+                    {"soulstone_rate", playerStats.soulstones / hits},
+                });
+            }
+        }, m_maxPlayers);
+
+        if (m_format == Format::Json)
+        {
+            QJsonArray targets;
+            dpsLogic.iterateTargets([&](const DpsLogic::TargetStats &targetStats) {
+                targets.append(QJsonObject {
+                    {"target", static_cast<double>(targetStats.targetId)},
+                    {"damage", static_cast<double>(targetStats.damage)},
+                    {"hp", static_cast<double>(targetStats.hp)},
+                    {"hp_loss_rate", targetStats.hpLossRate},
+                    {"time_to_kill", qIsNaN(targetStats.timeToKill) ? QJsonValue() : QJsonValue(targetStats.timeToKill)},
+                });
+            });
+
+            const QJsonObject report {
+                {"time", time},
+                {"world", static_cast<double>(worldId)},
+                {"players", players},
+                {"targets", targets},
+            };
+            m_file.write(QJsonDocument(report).toJson(QJsonDocument::Compact));
+            m_file.write("\n");
+        }
+
+        m_file.flush();
+    }
+
+private:
+    QFile m_file;
+    Format m_format = Format::Csv;
+    uint32_t m_maxPlayers = UINT32_MAX;
+    bool m_headerWritten = false;
+};
+
+// Aggregates a decoded event log, without any capture
+int replayEvents(const QString &fileName, Report &report, double interval)
+{
+    EventLogReader eventLog;
+    if (!eventLog.open(fileName))
+        return -1;
+
+    DpsLogic dpsLogic;
+    dpsLogic.setRealTime(false);
+
+    // Periodic reports in event time, so they don't depend on the machine
+    const int64_t intervalNs = interval * 1e9;
+    int64_t nextReport = eventLog.getFirstTimestamp() + intervalNs;
+
+    const bool ok = eventLog.read([&](const DpsEvent *events, size_t count) {
+        dpsLogic.ingest(events, count);
+
+        if (intervalNs > 0 && events[count - 1].timestamp >= nextReport)
+        {
+            if (dpsLogic.isValid())
+                report.write(dpsLogic);
+            nextReport = events[count - 1].timestamp + intervalNs;
+        }
+    });
+    report.write(dpsLogic);
+
+    if (!ok)
+    {
+        qCritical() << "Corrupt event log:" << fileName;
+        return -1;
+    }
+    return 0;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication::setSetuidAllowed(true);
+    QCoreApplication::setApplicationName("MiluDpsMeterCli");
+    QCoreApplication::setApplicationVersion(MILU_DPS_METER_VERSION);
+
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless DPS meter, prints the player statistics as CSV or JSON lines.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    Meter::addOptions(parser);
+    parser.addOptions({
+        {"format", "Output format: csv, json (default: csv).", "format", "csv"},
+        {"interval", "Print a report every N seconds, 0 prints only the final report (default: 0).", "seconds", "0"},
+        {"top", "Report only the N players with the most damage, 0 reports all of them (default: 0).", "players", "0"},
+        {"output", "Write the reports to the file instead of standard output.", "file"},
+        {"replay-events", "Aggregate a decoded event log instead of capturing packets.", "file"},
+        {"statistics", "Print the capture statistics to standard error at the end."},
+    });
+    parser.process(app);
+
+    Report::Format format;
+    if (parser.value("format") == "csv")
+    {
+        format = Report::Format::Csv;
+    }
+    else if (parser.value("format") == "json")
+    {
+        format = Report::Format::Json;
+    }
+    else
+    {
+        qCritical() << "Unknown output format:" << parser.value("format");
+        return -1;
+    }
+
+    bool intervalOk = false;
+    const double interval = parser.value("interval").toDouble(&intervalOk);
+    if (!intervalOk || interval < 0.0)
+    {
+        qCritical() << "Invalid report interval:" << parser.value("interval");
+        return -1;
+    }
+
+    bool topOk = false;
+    const uint32_t top = parser.value("top").toUInt(&topOk);
+    if (!topOk)
+    {
+        qCritical() << "Invalid number of players:" << parser.value("top");
+        return -1;
+    }
+
+    Report report;
+    if (!report.open(parser.value("output"), format, (top > 0) ? top : UINT32_MAX))
+    {
+        qCritical() << "Can't open output:" << parser.value("output");
+        return -1;
+    }
+
+    if (parser.isSet("replay-events"))
+        return replayEvents(parser.value("replay-events"), report, interval);
+
+    Meter meter;
+    if (!meter.create(parser))
+        return -1;
+
+    auto &dpsLogic = meter.getDpsLogic();
+
+    const auto finish = [&] {
+        report.write(dpsLogic);
+        if (parser.isSet("statistics"))
+        {
+            for (auto &&line : meter.getStatistics())
+                fprintf(stderr, "%s\n", qUtf8Printable(line));
+        }
+        app.quit();
+    };
+
+    QTimer reportTimer;
+    if (interval > 0.0)
+    {
+        QObject::connect(&reportTimer, &QTimer::timeout, &app, [&] {
+            if (dpsLogic.isValid())
+                report.write(dpsLogic);
+        });
+        reportTimer.start(interval * 1e3);
+    }
+
+    if (meter.isReplay())
+    {
+        QObject::connect(&meter, &Meter::replayFinished, &app, finish);
+    }
+
+    // Signal handlers can only set a flag, the event loop picks it up
+    signal(SIGINT, [](int) { g_stopRequested = true; });
+    signal(SIGTERM, [](int) { g_stopRequested = true; });
+
+    QTimer stopTimer;
+    QObject::connect(&stopTimer, &QTimer::timeout, &app, [&] {
+        if (g_stopRequested.exchange(false))
+            finish();
+    });
+    stopTimer.start(100);
+
+    if (!meter.start())
+        return -1;
+
+    const int ret = app.exec();
+
+    meter.finish();
+
+    return ret;
+}
@@ -1,14 +1,18 @@
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QFontDatabase>
 #include <QMessageBox>
 #include <QScreen>
 #include <QDebug>
 
-#include "SWPacketCapture.hpp"
-#include "DpsLogic.hpp"
+#include "Meter.hpp"
 #include "PacketCapture.hpp"
+#include "CaptureThread.hpp"
 
 #include "MainWindow.hpp"
+#include "OpCodeProfileDialog.hpp"
+
+using namespace std;
 
 int main(int argc, char *argv[])
 {
@@ -31,6 +35,13 @@ int main(int argc, char *argv[])
 
     QApplication app(argc, argv);
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addVersionOption();
+    Meter::addOptions(parser);
+    parser.addOption({"exit-after-replay", "Quit when the capture file has been replayed."});
+    parser.process(app);
+
     QApplication::setStyle("windows");
 
     QPalette pal(QColor(44, 44, 44));
@@ -45,53 +56,52 @@ int main(int argc, char *argv[])
     font.setBold(true);
     QApplication::setFont(font);
 
-    auto packetCapture = PacketCapture::create();
-    if (!packetCapture->init(15011))
+    Meter meter;
+    if (!meter.create(parser))
+        return -1;
+
+    if (meter.isReplay() && parser.isSet("exit-after-replay"))
+        QObject::connect(&meter, &Meter::replayFinished, &app, &QApplication::quit);
+
+    if (!meter.start())
     {
-        qWarning() << "Error initializing packet capture";
+        if (meter.isReplay())
+            return -1;
 #ifndef QT_DEBUG
         QMessageBox::warning(nullptr, QString(), "Can't grab packages, please run as root");
         return -1;
 #endif
     }
 
-    SWPacketCapture swPacketCapture;
-    QObject::connect(
-        packetCapture.get(), &PacketCapture::newPacket,
-        &swPacketCapture, &SWPacketCapture::newPacket,
-        Qt::DirectConnection
-    );
+    auto &captureThread = meter.getCaptureThread();
+
+    MainWindow win(meter.getDpsLogic());
+    win.move(app.primaryScreen()->availableSize().width() - win.width(), 0);
+    win.show();
 
-    DpsLogic dpsLogic;
-    QObject::connect(
-        &swPacketCapture, &SWPacketCapture::worldChange,
-        &dpsLogic, &DpsLogic::worldChange
-    );
-    QObject::connect(
-        &swPacketCapture, &SWPacketCapture::ownerId,
-        &dpsLogic, &DpsLogic::ownerId
-    );
     QObject::connect(
-        &swPacketCapture, &SWPacketCapture::damage,
-        &dpsLogic, &DpsLogic::damage
+        &win, &MainWindow::packetCaptureReset,
+        captureThread.getPacketCapture(), [&captureThread] {
+            captureThread.resetCapture();
+        }
     );
     QObject::connect(
-        &swPacketCapture, &SWPacketCapture::mazeEnd,
-        &dpsLogic, &DpsLogic::mazeEnd
+        &win, &MainWindow::statisticsRequested,
+        &win, [&] {
+            const auto lines = meter.getStatistics();
+            QMessageBox::information(&win, QObject::tr("Statistics"), lines.join('\n'));
+        }
     );
     QObject::connect(
-        &swPacketCapture, &SWPacketCapture::partyMember,
-        &dpsLogic, &DpsLogic::partyMember
+        &win, &MainWindow::profileRequested,
+        &win, [&] {
+            OpCodeProfileDialog::open(meter, &win);
+        }
     );
 
-    MainWindow win(dpsLogic);
-    win.move(app.primaryScreen()->availableSize().width() - win.width(), 0);
-    win.show();
+    const int ret = app.exec();
 
-    QObject::connect(
-        &win, &MainWindow::packetCaptureReset,
-        packetCapture.get(), &PacketCapture::reset
-    );
+    meter.finish();
 
-    return app.exec();
+    return ret;
 }